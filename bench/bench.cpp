@@ -0,0 +1,1043 @@
+// benchmarks for the library hot paths, results are printed as JSON
+// on stdout, one benchmark per line so they're easy to diff or grep.
+#include <anserial/anserial.hpp>
+#include <anserial/parser.hpp>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <math.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace anserial;
+
+// amount of work done by one run of a benchmark
+struct work {
+	uint64_t entities;
+	uint64_t bytes;
+};
+
+struct bench_result {
+	std::string name;
+	uint64_t iterations;
+	double seconds;
+	work done;
+};
+
+// minimum time to spend on each benchmark
+static double min_seconds = 0.25;
+
+// results that would otherwise be optimized out go here
+static volatile uint64_t sink;
+
+// xorshift, so generated data is the same on every run
+class rng {
+	public:
+		rng(uint32_t seed) : state(seed? seed : 1) {}
+
+		uint32_t next(void) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		uint32_t below(uint32_t n) { return next() % n; }
+
+	private:
+		uint32_t state;
+};
+
+static const char *words[] = {
+	"results", "count", "name", "value", "config", "entry", "id", "weight",
+	"alpha", "beta", "gamma", "delta", "enabled", "timeout", "host", "port",
+};
+
+static const size_t nwords = sizeof(words) / sizeof(words[0]);
+
+// synthetic trees, all modeled on gen_test_data() in the CLI tool
+enum shape { SHAPE_FLAT, SHAPE_DEEP, SHAPE_STRINGS, SHAPE_MAPS, SHAPE_RESULTS };
+
+static const char *shape_names[] = { "flat", "deep", "strings", "maps", "results" };
+
+static void gen_shape(serializer& ser, shape s, uint32_t target_entities) {
+	rng r(19937);
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	while (ser.ent_counter < target_entities) {
+		switch (s) {
+			case SHAPE_FLAT:
+				ser.add_integer(cont, r.next());
+				break;
+
+			case SHAPE_DEEP:
+				{
+					uint32_t cur = cont;
+					for (unsigned depth = 0; depth < 64; depth++) {
+						cur = ser.add_container(cur);
+						ser.add_integer(cur, depth);
+					}
+				}
+				break;
+
+			case SHAPE_STRINGS:
+				{
+					std::string str;
+					unsigned len = 8 + r.below(56);
+					for (unsigned i = 0; i < len; i++) {
+						str += 'a' + r.below(26);
+					}
+					ser.add_string(cont, str);
+				}
+				break;
+
+			case SHAPE_MAPS:
+				{
+					uint32_t map = ser.add_map(cont);
+					for (size_t i = 0; i < nwords; i++) {
+						ser.add_symbol(map, words[i]);
+						ser.add_integer(map, r.next());
+					}
+				}
+				break;
+
+			case SHAPE_RESULTS:
+				{
+					uint32_t i = r.next();
+					ser.add_entities(cont,
+						{"results",
+							{"i-19937", i*19937},
+							{"i-2048",  i*2048}});
+				}
+				break;
+		}
+	}
+
+	ser.add_symtab(0);
+}
+
+static std::vector<uint32_t> gen_buffer(shape s, uint32_t target_entities,
+                                        ent_order order = ORDER_NETWORK)
+{
+	serializer ser;
+	ser.order = order;
+	gen_shape(ser, s, target_entities);
+	return ser.serialize();
+}
+
+// the results shape again, with about 1% of its records changed and as
+// many again removed or inserted
+static std::vector<uint32_t> gen_edited_results(uint32_t target_entities, uint32_t seed) {
+	serializer ser;
+	rng r(19937), edits(seed);
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	while (ser.ent_counter < target_entities) {
+		uint32_t i = r.next();
+
+		switch (edits.below(200)) {
+			case 0:
+				continue;
+
+			case 1:
+				ser.add_entities(cont,
+					{"results",
+						{"i-19937", edits.next()},
+						{"i-2048",  edits.next()}});
+				break;
+
+			case 2:
+			case 3:
+				i = edits.next();
+				break;
+		}
+
+		ser.add_entities(cont,
+			{"results",
+				{"i-19937", i*19937},
+				{"i-2048",  i*2048}});
+	}
+
+	ser.add_symtab(0);
+	return ser.serialize();
+}
+
+static work buffer_work(const std::vector<uint32_t>& buf) {
+	return {buf.size() / 2, buf.size() * 4};
+}
+
+static bench_result run(const std::string& name, std::function<work()> fn) {
+	using clock = std::chrono::steady_clock;
+	bench_result ret = {name, 0, 0, {0, 0}};
+
+	fprintf(stderr, "; running %s...\n", name.c_str());
+
+	// warm up once, then keep going until the minimum time has passed
+	fn();
+	auto start = clock::now();
+
+	do {
+		work w = fn();
+		ret.iterations++;
+		ret.done.entities += w.entities;
+		ret.done.bytes += w.bytes;
+		ret.seconds = std::chrono::duration<double>(clock::now() - start).count();
+	} while (ret.seconds < min_seconds);
+
+	return ret;
+}
+
+// stdout is used for results, so temporarily point it at /dev/null for
+// benchmarks that print things
+class silence_stdout {
+	public:
+		silence_stdout() {
+			fflush(stdout);
+			saved = dup(1);
+			int fd = open("/dev/null", O_WRONLY);
+			dup2(fd, 1);
+			close(fd);
+		}
+
+		~silence_stdout() {
+			fflush(stdout);
+			std::cout.flush();
+			dup2(saved, 1);
+			close(saved);
+		}
+
+	private:
+		int saved;
+};
+
+static std::string gen_sexp(uint32_t records) {
+	rng r(2048);
+	std::string ret = "(";
+
+	for (uint32_t i = 0; i < records; i++) {
+		ret += "(results (i-19937 " + std::to_string(r.below(1000000))
+		     + ") (i-2048 " + std::to_string(r.below(1000000))
+		     + ") \"" + words[r.below(nwords)] + "\")\n";
+	}
+
+	return ret + ")\n";
+}
+
+// record type for the struct binding benchmarks
+struct bench_record {
+	uint32_t i_19937;
+	uint32_t i_2048;
+};
+
+ANSERIAL_BINDING(bench_record,
+	ANSERIAL_FIELD(i_19937),
+	ANSERIAL_FIELD(i_2048));
+
+static std::vector<bench_result> run_all(void) {
+	std::vector<bench_result> results;
+	const uint32_t N = 200000;
+
+	// serializer, primitives vs. ent_int trees
+	results.push_back(run("serializer/primitives", [&] {
+		serializer ser;
+		uint32_t top = ser.default_layout();
+		uint32_t cont = ser.add_container(top);
+
+		for (uint32_t i = 0; ser.ent_counter < N; i++) {
+			uint32_t k = ser.add_container(cont);
+			ser.add_symbol(k, "results");
+
+			uint32_t sub = ser.add_container(k);
+			ser.add_symbol(sub, "i-19937");
+			ser.add_integer(sub, i*19937);
+
+			sub = ser.add_container(k);
+			ser.add_symbol(sub, "i-2048");
+			ser.add_integer(sub, i*2048);
+		}
+
+		return buffer_work(ser.output);
+	}));
+
+	results.push_back(run("serializer/add_entities", [&] {
+		serializer ser;
+		uint32_t top = ser.default_layout();
+		uint32_t cont = ser.add_container(top);
+
+		for (uint32_t i = 0; ser.ent_counter < N; i++) {
+			ser.add_entities(cont,
+				{"results",
+					{"i-19937", i*19937},
+					{"i-2048",  i*2048}});
+		}
+
+		return buffer_work(ser.output);
+	}));
+
+	results.push_back(run("serializer/add_entities-dedup", [&] {
+		serializer ser;
+		ser.dedup = true;
+		uint32_t top = ser.default_layout();
+		uint32_t cont = ser.add_container(top);
+
+		uint64_t records = 0;
+
+		for (uint32_t i = 0; ser.ent_counter < N/4; i++) {
+			ser.add_entities(cont,
+				{"results",
+					{"i-19937", (i % 64)*19937},
+					{"i-2048",  (i % 64)*2048}});
+			records++;
+		}
+
+		// count the entities that went in, 8 per record, rather than
+		// what came out
+		return work{records*8, records*8*8};
+	}));
+
+	// deserializer, over each tree shape
+	for (shape s : {SHAPE_FLAT, SHAPE_DEEP, SHAPE_STRINGS, SHAPE_MAPS, SHAPE_RESULTS}) {
+		auto buf = gen_buffer(s, N);
+
+		results.push_back(run(std::string("deserializer/") + shape_names[s], [&] {
+			deserializer der(buf.data(), buf.size() / 2);
+			// the tree is owned by the top-level node
+			delete der.deserialize();
+			return buffer_work(buf);
+		}));
+	}
+
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+
+		results.push_back(run("compact_tree/results", [&] {
+			compact_tree tree(buf);
+			return buffer_work(buf);
+		}));
+	}
+
+	for (ent_order order : {ORDER_NETWORK, ORDER_NATIVE}) {
+		auto buf = gen_buffer(SHAPE_RESULTS, N, order);
+
+		results.push_back(run(order == ORDER_NATIVE? "validate/results-native" : "validate/results", [&] {
+			sink = validate(buf).ok();
+			return buffer_work(buf);
+		}));
+	}
+
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N, ORDER_NATIVE);
+
+		results.push_back(run("deserializer/results-native", [&] {
+			deserializer der(buf.data(), buf.size() / 2);
+			delete der.deserialize();
+			return buffer_work(buf);
+		}));
+	}
+
+	// saving and restoring a finished decode
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+		deserializer der(buf.data(), buf.size() / 2);
+		auto saved = der.checkpoint(buf.size() * 4);
+
+		results.push_back(run("deserializer/checkpoint", [&] {
+			sink = der.checkpoint(buf.size() * 4).size();
+			return buffer_work(buf);
+		}));
+
+		results.push_back(run("deserializer/restore", [&] {
+			deserializer restored;
+			sink = restored.restore(saved);
+			delete restored.deserialize();
+			return buffer_work(buf);
+		}));
+
+		delete der.deserialize();
+	}
+
+	// the same, for an ingest that only fires events
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+		deserializer_events ev;
+		deserializer der;
+		der.events = &ev;
+		der.build_nodes = false;
+		der.deserialize(buf.data(), buf.size() / 2);
+		auto saved = der.checkpoint(buf.size() * 4);
+
+		results.push_back(run("deserializer/checkpoint-events", [&] {
+			sink = der.checkpoint(buf.size() * 4).size();
+			return buffer_work(buf);
+		}));
+
+		results.push_back(run("deserializer/restore-events", [&] {
+			deserializer restored;
+			restored.events = &ev;
+			restored.build_nodes = false;
+			sink = restored.restore(saved);
+			return buffer_work(buf);
+		}));
+	}
+
+	// events only, summing integers without building any nodes
+	{
+		struct summer : deserializer_events {
+			uint64_t sum = 0;
+			void on_integer(uint32_t parent, uint32_t id, uint32_t value) {
+				sum += value;
+			}
+		};
+
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+
+		results.push_back(run("deserializer/results-events", [&] {
+			summer sum;
+			deserializer der;
+			der.events = &sum;
+			der.build_nodes = false;
+			der.deserialize(buf.data(), buf.size() / 2);
+			der.finish();
+			return buffer_work(buf);
+		}));
+	}
+
+	// decoding from a pipe, with another thread writing into it
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+
+		for (bool ahead : {false, true}) {
+			results.push_back(run(ahead? "stream_reader/pipe-readahead" : "stream_reader/pipe", [&] {
+				int fds[2];
+				if (pipe(fds) < 0) {
+					return work{0, 0};
+				}
+
+				std::thread writer([&] {
+					const uint8_t *p = (const uint8_t*)buf.data();
+					size_t left = buf.size() * 4;
+
+					while (left > 0) {
+						ssize_t n = write(fds[1], p, left);
+						if (n <= 0) break;
+						p += n;
+						left -= n;
+					}
+
+					close(fds[1]);
+				});
+
+				deserializer der;
+				stream_reader input(fds[0], stream_reader::DEFAULT_BLOCK_SIZE, ahead);
+				input.feed(der);
+				delete der.deserialize();
+
+				writer.join();
+				close(fds[0]);
+				return buffer_work(buf);
+			}));
+		}
+	}
+
+	// framed messages over a loopback socket pair, decoding each one.
+	// entities here count messages rather than entities.
+	for (uint32_t size : {16u, 65536u}) {
+		serializer ser;
+		uint32_t top = ser.default_layout();
+
+		while (ser.ent_counter < size) {
+			ser.add_integer(top, ser.ent_counter);
+		}
+
+		const unsigned messages = (size < 1024)? 65536 : 64;
+
+		results.push_back(run(std::string("framing/") + ((size < 1024)? "small" : "large"), [&] {
+			int fds[2];
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+				return work{0, 0};
+			}
+
+			std::thread sender([&] {
+				frame_writer out(fds[0]);
+
+				for (unsigned i = 0; i < messages; i++) {
+					out.queue(ser);
+
+					// batch small messages up, one writev() per 64
+					if (out.pending() == 64) {
+						out.flush();
+					}
+				}
+
+				out.flush();
+				close(fds[0]);
+			});
+
+			frame_reader in(fds[1]);
+			frame_reader::frame f;
+			uint64_t n = 0, bytes = 0;
+
+			while (in.next(f)) {
+				compact_tree tree(f.datas, f.entities);
+				bytes += FRAME_HEADER + 8*f.entities;
+				n += tree.size() > 0;
+			}
+
+			sender.join();
+			close(fds[1]);
+			return work{n, bytes};
+		}));
+	}
+
+	// point lookups through an index footer, counting the entities
+	// actually decoded
+	{
+		serializer ser;
+		rng r(19937);
+		uint32_t top = ser.default_layout();
+
+		while (ser.ent_counter < N) {
+			ser.add_entities(top, {"id", r.next(), {"score", r.below(1000)}});
+		}
+
+		ser.add_symtab(0);
+		ser.add_index(0);
+		auto buf = ser.serialize();
+		indexed_reader index(buf.data(), buf.size() / 2);
+
+		results.push_back(run("index/record", [&] {
+			uint64_t n = 0;
+
+			for (unsigned i = 0; i < 1024; i++) {
+				auto sub = index.record(r.below(index.records()));
+				deserializer der(sub);
+				delete der.deserialize();
+				n += sub.size() / 2;
+			}
+
+			return work{n, n*8};
+		}));
+	}
+
+	// live tree ingest in 4096-entity chunks, with and without a reader
+	// taking snapshots the whole time
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+		const size_t chunk = 4096;
+
+		for (bool reading : {false, true}) {
+			results.push_back(run(reading? "live_tree/ingest-snapshots" : "live_tree/ingest", [&] {
+				live_tree tree;
+				std::atomic<bool> done(false);
+				std::thread reader;
+
+				if (reading) {
+					reader = std::thread([&] {
+						uint64_t n = 0;
+
+						while (!done.load(std::memory_order_relaxed)) {
+							live_snapshot snap = tree.snapshot();
+							n += snap.get(snap.data(), 0u) != live_snapshot::npos;
+						}
+
+						(void)n;
+					});
+				}
+
+				size_t ents = buf.size() / 2;
+
+				for (size_t i = 0; i < ents; i += chunk) {
+					tree.deserialize(buf.data() + 2*i, std::min(chunk, ents - i));
+				}
+
+				done = true;
+				if (reader.joinable()) {
+					reader.join();
+				}
+
+				return buffer_work(buf);
+			}));
+		}
+	}
+
+	// alternative layouts
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+		auto col = columnar_encode(buf);
+		auto z = compress_entities(buf);
+
+		results.push_back(run("columnar/encode", [&] {
+			auto out = columnar_encode(buf);
+			return buffer_work(buf);
+		}));
+
+		results.push_back(run("columnar/decode", [&] {
+			auto out = columnar_decode(col.data(), col.size());
+			return buffer_work(out);
+		}));
+
+		results.push_back(run("compress/compress", [&] {
+			auto out = compress_entities(buf);
+			return buffer_work(buf);
+		}));
+
+		results.push_back(run("compress/decompress", [&] {
+			compressed_reader reader(z.data(), z.size());
+			auto out = reader.decompress(1);
+			return buffer_work(out);
+		}));
+	}
+
+	// patches between snapshots with records changed, inserted and removed
+	{
+		auto base = gen_buffer(SHAPE_RESULTS, N);
+		auto target = gen_edited_results(N, 2048);
+		auto patch = make_patch(base, target);
+
+		results.push_back(run("diff/make", [&] {
+			auto out = make_patch(base, target);
+			return buffer_work(target);
+		}));
+
+		results.push_back(run("diff/apply", [&] {
+			auto out = apply_patch(base, patch);
+			return buffer_work(out);
+		}));
+	}
+
+	// membership tests on a set of 4096 integers
+	{
+		serializer ser;
+		uint32_t set = ser.add_set(ser.default_layout());
+		rng r(4096);
+
+		for (unsigned i = 0; i < 4096; i++) {
+			ser.add_integer(set, r.below(65536));
+		}
+
+		auto buf = ser.serialize();
+		deserializer der(buf.data(), buf.size() / 2);
+		s_tree tree(&der);
+		s_node *node = tree.data()->get(0);
+
+		results.push_back(run("s_set/contains", [&] {
+			uint64_t n = 0;
+
+			for (uint32_t i = 0; i < 65536; i++) {
+				n += node->contains(i);
+			}
+
+			sink = n;
+			return work{65536, 65536*8};
+		}));
+	}
+
+	// symbol-heavy documents, names resolved one at a time through the
+	// ::symtab map, or in bulk through a symbol_table
+	{
+		const uint32_t nsyms = 4096;
+		serializer ser;
+		uint32_t cont = ser.add_container(ser.default_layout());
+
+		for (uint32_t i = 0; i < nsyms; i++) {
+			ser.add_symbol(cont, "symbol-" + std::to_string(i));
+		}
+
+		ser.add_symtab(0);
+		auto buf = ser.serialize();
+
+		deserializer der(buf.data(), buf.size() / 2);
+		s_tree tree(&der);
+		s_node *node = tree.data()->get(0);
+
+		results.push_back(run("s_tree/lookup", [&] {
+			uint64_t n = 0;
+
+			for (s_node *x : node->entities()) {
+				n += tree.lookup(x->uint())->string().size();
+			}
+
+			sink = n;
+			return work{nsyms, nsyms*8};
+		}));
+
+		results.push_back(run("symbol_table/resolve", [&] {
+			std::vector<std::string_view> names;
+			uint64_t n = 0;
+
+			tree.symbols().resolve(node, names);
+
+			for (auto& name : names) {
+				n += name.size();
+			}
+
+			sink = n;
+			return work{nsyms, nsyms*8};
+		}));
+
+		results.push_back(run("symbol_table/load", [&] {
+			symbol_table syms(buf.data(), buf.size() / 2);
+			sink = syms.size();
+			return buffer_work(buf);
+		}));
+	}
+
+	// lookups and pattern matching on an already deserialized tree
+	{
+		auto buf = gen_buffer(SHAPE_MAPS, N);
+		deserializer der(buf.data(), buf.size() / 2);
+		s_tree tree(&der);
+		std::vector<s_node*>& maps = tree.data()->get(0)->entities();
+
+		results.push_back(run("s_map/get", [&] {
+			uint64_t n = 0;
+
+			for (s_node *map : maps) {
+				for (size_t i = 0; i < nwords; i++) {
+					n += map->get(words[i]) != nullptr;
+				}
+			}
+
+			return work{n, n*8};
+		}));
+
+		// concurrent readers on a frozen tree, throughput should scale
+		// with the thread count up to the number of cores
+		tree.freeze();
+
+		for (unsigned nthreads : {1, 2, 4, 8}) {
+			results.push_back(run("s_tree/frozen-read-" + std::to_string(nthreads) + "t", [&] {
+				std::vector<std::thread> threads;
+				std::atomic<uint64_t> total(0);
+
+				for (unsigned t = 0; t < nthreads; t++) {
+					threads.emplace_back([&] {
+						uint64_t n = 0;
+
+						for (s_node *map : maps) {
+							for (size_t i = 0; i < nwords; i++) {
+								n += tree.lookup(hash_string(words[i])) == nullptr;
+								n += map->get(words[i]) != nullptr;
+							}
+						}
+
+						total += n;
+					});
+				}
+
+				for (auto& t : threads) {
+					t.join();
+				}
+
+				return work{total.load(), total.load()*8};
+			}));
+		}
+
+		compact_tree compact(buf);
+		uint32_t list = compact.get(compact.data(), 0u);
+
+		results.push_back(run("compact_tree/get", [&] {
+			uint64_t n = 0;
+
+			for (uint32_t i = 0; i < compact.count(list); i++) {
+				uint32_t map = compact.get(list, i);
+
+				for (size_t k = 0; k < nwords; k++) {
+					n += compact.get(map, words[k]) != compact_tree::npos;
+				}
+			}
+
+			return work{n, n*8};
+		}));
+	}
+
+	{
+		auto buf = gen_buffer(SHAPE_RESULTS, N);
+		deserializer der(buf.data(), buf.size() / 2);
+		s_tree tree(&der);
+		std::vector<s_node*>& records = tree.data()->get(0)->entities();
+
+		results.push_back(run("destructure/results", [&] {
+			uint64_t n = 0;
+
+			for (s_node *node : records) {
+				uint32_t a, b;
+				n += destructure(node,
+					{"results",
+						{"i-19937", &a},
+						{"i-2048", &b}});
+			}
+
+			// each record is 7 entities
+			return work{n*7, n*7*8};
+		}));
+
+		// same fields, read straight into structs
+		std::vector<bench_record> values;
+
+		for (uint32_t i = 0; i < N/5; i++) {
+			values.push_back({i*19937, i*2048});
+		}
+
+		results.push_back(run("binding/encode", [&] {
+			serializer ser;
+			uint32_t top = ser.default_layout();
+			encode(ser, top, values);
+			return buffer_work(ser.output);
+		}));
+
+		serializer ser;
+		uint32_t list = encode(ser, ser.default_layout(), values);
+		auto bound = ser.serialize();
+
+		results.push_back(run("binding/decode", [&] {
+			std::vector<bench_record> out;
+			decode(bound, list, out);
+			return buffer_work(bound);
+		}));
+
+		// lazy typed access to the same records, straight from the buffer
+		detail::raw_reader raw = {bound.data(), bound.size() / 2, ORDER_NETWORK};
+
+		results.push_back(run("view/get", [&] {
+			list_view<bench_record> records(raw, list);
+			uint64_t sum = 0;
+
+			for (size_t i = 0; i < records.size(); i++) {
+				auto v = records[i];
+				sum += v.get<&bench_record::i_19937>() + v.get<&bench_record::i_2048>();
+			}
+
+			sink = sum;
+			return buffer_work(bound);
+		}));
+
+		results.push_back(run("s_tree/dump_nodes", [&] {
+			silence_stdout quiet;
+			tree.dump_nodes();
+			return buffer_work(buf);
+		}));
+	}
+
+	{
+		std::string text = gen_sexp(N / 10);
+
+		results.push_back(run("sexp_parser/parse", [&] {
+			FILE *fp = fmemopen((void*)text.data(), text.size(), "r");
+			sexp_parser parser(fp);
+			s_tree tree = parser.parse();
+			fclose(fp);
+
+			// 10 entities per record
+			return work{(uint64_t)N, text.size()};
+		}));
+	}
+
+	return results;
+}
+
+// results over several repetitions of the whole suite
+struct bench_summary {
+	std::string name;
+	size_t samples;
+	// medians, and a ~95% confidence interval for the entities/s median
+	double entities_per_sec;
+	double mb_per_sec;
+	double ci_low;
+	double ci_high;
+};
+
+static double median(std::vector<double> xs) {
+	std::sort(xs.begin(), xs.end());
+	size_t n = xs.size();
+	return (n % 2)? xs[n/2] : (xs[n/2 - 1] + xs[n/2]) / 2;
+}
+
+static std::vector<bench_summary> run_repeated(unsigned reps) {
+	std::vector<std::string> names;
+	std::map<std::string, std::vector<double>> eps, mbps;
+
+	for (unsigned i = 0; i < reps; i++) {
+		fprintf(stderr, "; repetition %u/%u\n", i + 1, reps);
+
+		for (const bench_result& r : run_all()) {
+			if (eps.find(r.name) == eps.end()) {
+				names.push_back(r.name);
+			}
+
+			eps[r.name].push_back(r.done.entities / r.seconds);
+			mbps[r.name].push_back(r.done.bytes / r.seconds / (1024.0*1024.0));
+		}
+	}
+
+	std::vector<bench_summary> ret;
+
+	for (const std::string& name : names) {
+		std::vector<double> xs = eps[name];
+		std::sort(xs.begin(), xs.end());
+
+		// distribution-free interval for the median, from the ranks
+		// n/2 -+ 1.96*sqrt(n)/2 of the sorted samples
+		double n = xs.size();
+		double spread = 0.98*sqrt(n);
+		long lo = floor(n/2 - spread);
+		long hi = ceil(n/2 + spread);
+		lo = (lo < 0)? 0 : lo;
+		hi = (hi > (long)xs.size() - 1)? (long)xs.size() - 1 : hi;
+
+		ret.push_back({name, xs.size(), median(xs), median(mbps[name]), xs[lo], xs[hi]});
+	}
+
+	return ret;
+}
+
+static void print_json(const std::vector<bench_summary>& results) {
+	printf("{\n");
+	printf("\"version\": \"%u.%u.%u\",\n", version.major, version.minor, version.patch);
+	printf("\"benchmarks\": [\n");
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const bench_summary& r = results[i];
+
+		printf("{\"name\": \"%s\", \"samples\": %lu, "
+		       "\"entities_per_sec\": %.1f, \"mb_per_sec\": %.3f, "
+		       "\"ci_low\": %.1f, \"ci_high\": %.1f}%s\n",
+		       r.name.c_str(), (unsigned long)r.samples,
+		       r.entities_per_sec, r.mb_per_sec, r.ci_low, r.ci_high,
+		       (i + 1 < results.size())? "," : "");
+	}
+
+	printf("]\n}\n");
+}
+
+// reads entities/s for each benchmark from the output of print_json(),
+// which puts each benchmark on its own line
+static std::map<std::string, double> read_baseline(const char *path) {
+	std::map<std::string, double> ret;
+	FILE *fp = fopen(path, "r");
+
+	if (!fp) {
+		fprintf(stderr, "; couldn't open baseline %s: %s\n", path, strerror(errno));
+		exit(2);
+	}
+
+	char line[1024];
+	while (fgets(line, sizeof(line), fp)) {
+		char name[256];
+		const char *eps = strstr(line, "\"entities_per_sec\": ");
+
+		if (sscanf(line, "{\"name\": \"%255[^\"]\"", name) == 1 && eps) {
+			ret[name] = atof(eps + strlen("\"entities_per_sec\": "));
+		}
+	}
+
+	fclose(fp);
+	return ret;
+}
+
+// compares results against a baseline, a benchmark regresses if its median
+// is more than 'threshold' percent slower than the baseline, and the top of
+// its confidence interval is slower too, so the slowdown isn't just noise.
+// with only a few samples the interval is the whole range of them.
+// returns false if anything regressed.
+static bool check_baseline(const std::vector<bench_summary>& results,
+                           const char *path, double threshold)
+{
+	std::map<std::string, double> baseline = read_baseline(path);
+	bool ok = true;
+
+	fprintf(stderr, "\n; %-32s %14s %14s %8s  %s\n",
+	        "benchmark", "baseline", "median", "change", "status");
+
+	for (const bench_summary& r : results) {
+		auto it = baseline.find(r.name);
+
+		if (it == baseline.end() || it->second <= 0) {
+			fprintf(stderr, "; %-32s %14s %14.0f %8s  new\n",
+			        r.name.c_str(), "-", r.entities_per_sec, "-");
+			continue;
+		}
+
+		double change = 100.0*(r.entities_per_sec - it->second) / it->second;
+		bool regressed = r.entities_per_sec < it->second*(1.0 - threshold/100.0)
+		                 && r.ci_high < it->second;
+		ok = ok && !regressed;
+
+		fprintf(stderr, "; %-32s %14.0f %14.0f %+7.1f%%  %s\n",
+		        r.name.c_str(), it->second, r.entities_per_sec, change,
+		        regressed? "REGRESSED" : "ok");
+	}
+
+	fprintf(stderr, "; %s (threshold: %.1f%%)\n",
+	        ok? "no regressions" : "performance regressions found", threshold);
+	return ok;
+}
+
+static void print_help(void) {
+	printf(
+		" -h       : print this help and exit\n"
+		" -m sec   : minimum time to spend on each benchmark (default 0.25)\n"
+		" -r reps  : number of times to repeat the suite (default 1)\n"
+		" -b file  : compare results against a baseline file\n"
+		" -t pct   : slowdown allowed before failing against the baseline (default 20)\n"
+	);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned reps = 1;
+	const char *baseline = nullptr;
+	// medians of a few runs still vary by 10% or so on a busy machine
+	double threshold = 20;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "hm:r:b:t:")) != -1) {
+		switch (opt) {
+			case 'm':
+				min_seconds = atof(optarg);
+				break;
+
+			case 'r':
+				reps = atoi(optarg);
+				reps = reps? reps : 1;
+				break;
+
+			case 'b':
+				baseline = optarg;
+				break;
+
+			case 't':
+				threshold = atof(optarg);
+				break;
+
+			case 'h':
+				print_help();
+				return 0;
+
+			default:
+				print_help();
+				return 1;
+		}
+	}
+
+	auto results = run_repeated(reps);
+	print_json(results);
+
+	if (baseline && !check_baseline(results, baseline, threshold)) {
+		return 1;
+	}
+
+	return 0;
+}
@@ -5,14 +5,8 @@ using namespace anserial;
 int main(int argc, char *argv[]) {
 	deserializer der;
 
-	// TODO: we should make some deserializer functions that can handle
-	//       input from file streams
-	uint32_t buf[1024];
-	size_t nred = 0;
-
-	while ((nred = fread(buf, 8, 512, stdin)) > 0) {
-		der.deserialize(buf, nred);
-	}
+	stream_reader input(stdin);
+	input.feed(der);
 
 	s_tree foo(&der);
 	s_node *results = nullptr;
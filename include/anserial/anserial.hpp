@@ -9,6 +9,22 @@
 #include <anserial/deserializer.hpp>
 #include <anserial/s_node.hpp>
 #include <anserial/s_tree.hpp>
+#include <anserial/columnar.hpp>
+#include <anserial/compress.hpp>
+#include <anserial/mapped_file.hpp>
+#include <anserial/mutable_view.hpp>
+#include <anserial/stats.hpp>
+#include <anserial/symbol_table.hpp>
+#include <anserial/compact_tree.hpp>
+#include <anserial/live_tree.hpp>
+#include <anserial/stream_reader.hpp>
+#include <anserial/index.hpp>
+#include <anserial/record_log.hpp>
+#include <anserial/framing.hpp>
+#include <anserial/binding.hpp>
+#include <anserial/view.hpp>
+#include <anserial/diff.hpp>
+#include <anserial/validate.hpp>
 
 namespace anserial {
 
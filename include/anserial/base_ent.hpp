@@ -1,10 +1,27 @@
 // definition of low-level binary entities and constants
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 #include <string>
+#include <string_view>
+
+// for htonl/ntohl
+#include <arpa/inet.h>
 
 namespace anserial {
 
+// hash of a symbol name, which is what's stored in place of the name.
+// this is the only definition, so everything hashing names agrees.
+constexpr uint32_t hash_symbol(std::string_view str) {
+	unsigned hash = 19937;
+
+	for (char c : str) {
+		hash = (hash << 7) + hash + c;
+	}
+
+	return hash;
+}
+
 // TODO: move this somewhere better
 //       like a string class or whatever
 uint32_t hash_string(const std::string& str);
@@ -22,8 +39,46 @@ enum {
 	// TODO: dno't know if we'll keep these
 	ENT_TYPE_SET,
 	ENT_TYPE_NULL,
+
+	// back-reference to an identical subtree written earlier, the
+	// data word holds the ID of the subtree's top entity
+	ENT_TYPE_REF,
+};
+
+// byte order of serialized entities. network byte order is the default and
+// is portable, native order skips byte swapping on both ends but is only
+// readable on hosts with the same endianness.
+//
+// native streams are flagged by ORDER_MARK in the data word of the
+// top-level entity (maps already use it, other types without data get it
+// when serialized in native order), see detect_order(). integers and
+// symbols need their data word, so they can't be the top entity of a
+// native stream.
+enum ent_order {
+	ORDER_NETWORK,
+	ORDER_NATIVE,
 };
 
+static const uint32_t ORDER_MARK = 0xcafebabe;
+
+// whether a top-level entity of this type has room for ORDER_MARK
+static inline bool carries_order_mark(uint32_t type) {
+	return type == ENT_TYPE_CONTAINER
+	    || type == ENT_TYPE_STRING
+	    || type == ENT_TYPE_MAP
+	    || type == ENT_TYPE_SET
+	    || type == ENT_TYPE_NULL;
+}
+
+// converts a serialized word to/from host byte order
+static inline uint32_t load_word(uint32_t word, ent_order order) {
+	return (order == ORDER_NATIVE)? word : ntohl(word);
+}
+
+static inline uint32_t store_word(uint32_t word, ent_order order) {
+	return (order == ORDER_NATIVE)? word : htonl(word);
+}
+
 typedef struct { uint32_t datas[2]; } serialized;
 
 class s_ent {
@@ -38,5 +93,12 @@ class s_ent {
 		uint32_t d_type;
 };
 
+serialized serialize_ent(const s_ent& ent, ent_order order = ORDER_NETWORK);
+s_ent deserialize_ent(const serialized& ser, ent_order order = ORDER_NETWORK);
+
+// guesses the byte order of a stream from its first entity, streams
+// without a byte order mark are assumed to be in network byte order
+ent_order detect_order(const uint32_t *datas, size_t entities);
+
 // namespace anserial
 }
@@ -0,0 +1,364 @@
+// struct bindings
+//
+// describes the fields of a struct once, and generates encoders and
+// decoders for it at compile time:
+//
+//   struct result {
+//       uint32_t id;
+//       std::string name;
+//       std::vector<uint32_t> samples;
+//   };
+//
+//   ANSERIAL_BINDING(result,
+//       ANSERIAL_FIELD(id),
+//       ANSERIAL_FIELD(name),
+//       ANSERIAL_FIELD(samples));
+//
+//   anserial::encode(ser, data, some_result);
+//   anserial::decode(buf, id, some_result);
+//
+// bound structs are written as maps keyed by field name, integers (and
+// enums and bools) as integers, std::strings as strings, and std::vectors
+// as containers, so the output is the same as writing it by hand and can
+// be read with anything else. ANSERIAL_BINDING has to be used at global
+// scope.
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <anserial/serializer.hpp>
+#include <anserial/stats.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace anserial {
+
+// specialized by ANSERIAL_BINDING
+template <typename T>
+struct binding;
+
+template <typename C, typename M>
+struct field {
+	using member_type = M;
+
+	const char *name;
+	uint32_t hash;
+	M C::*member;
+};
+
+template <typename C, typename M>
+constexpr field<C, M> make_field(const char *name, M C::*member) {
+	return {name, hash_symbol(name), member};
+}
+
+#define ANSERIAL_BINDING(TYPE, ...) \
+	template <> struct anserial::binding<TYPE> { \
+		using type = TYPE; \
+		static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
+	}
+
+#define ANSERIAL_FIELD(NAME) anserial::make_field(#NAME, &type::NAME)
+
+template <typename T, typename = void>
+struct is_bound : std::false_type {};
+
+template <typename T>
+struct is_bound<T, std::void_t<decltype(binding<T>::fields)>> : std::true_type {};
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename T, typename A>
+struct is_vector<std::vector<T, A>> : std::true_type {};
+
+namespace detail {
+
+template <typename T>
+constexpr bool is_scalar_field(void) {
+	return std::is_integral_v<T> || std::is_enum_v<T>;
+}
+
+// integers are written as one 32-bit word, wider fields would be cut short
+template <typename T>
+constexpr void check_scalar_width(void) {
+	static_assert(sizeof(T) <= sizeof(uint32_t),
+	              "integer fields wider than 32 bits can't be encoded");
+}
+
+// true for bound structs with only scalar fields, which always encode to
+// the same shape and can be laid out in bulk
+template <typename T>
+constexpr bool is_flat(void) {
+	if constexpr (is_bound<T>::value) {
+		return std::apply([](const auto&... f) {
+			return (is_scalar_field<typename std::decay_t<decltype(f)>::member_type>() && ...);
+		}, binding<T>::fields);
+
+	} else {
+		return false;
+	}
+}
+
+template <typename T>
+void add_symbols(serializer& ser) {
+	if constexpr (is_bound<T>::value) {
+		std::apply([&](const auto&... f) {
+			((ser.symtab.emplace(f.hash, f.name),
+			  add_symbols<typename std::decay_t<decltype(f)>::member_type>(ser)), ...);
+		}, binding<T>::fields);
+
+	} else if constexpr (is_vector<T>::value) {
+		add_symbols<typename T::value_type>(ser);
+	}
+}
+
+template <typename T>
+uint32_t encode_value(serializer& ser, uint32_t parent, const T& value);
+
+// each record is a map followed by symbol/integer pairs, so the entities
+// can be written straight to the output
+template <typename V>
+void encode_flat(serializer& ser, uint32_t cont, const V& values) {
+	using T = typename V::value_type;
+	constexpr size_t nfields = std::tuple_size_v<std::decay_t<decltype(binding<T>::fields)>>;
+	const ent_order order = ser.order;
+
+	size_t base = ser.output.size();
+	ser.output.resize(base + 2*values.size()*(1 + 2*nfields));
+
+	uint32_t *out = ser.output.data() + base;
+	uint32_t id = ser.ent_counter;
+
+	for (const T& value : values) {
+		uint32_t map = id++;
+		out[0] = store_word((ENT_TYPE_MAP << 29) | cont, order);
+		out[1] = store_word(ORDER_MARK, order);
+		out += 2;
+
+		std::apply([&](const auto&... f) {
+			(check_scalar_width<typename std::decay_t<decltype(f)>::member_type>(), ...);
+			((out[0] = store_word((ENT_TYPE_SYMBOL << 29) | map, order),
+			  out[1] = store_word(f.hash, order),
+			  out[2] = store_word((ENT_TYPE_INTEGER << 29) | map, order),
+			  out[3] = store_word((uint32_t)(value.*(f.member)), order),
+			  out += 4), ...);
+		}, binding<T>::fields);
+
+		id += 2*nfields;
+	}
+
+	ser.ent_counter = id;
+
+	stat_add_out(ENT_TYPE_MAP, values.size());
+	stat_add_out(ENT_TYPE_SYMBOL, values.size()*nfields);
+	stat_add_out(ENT_TYPE_INTEGER, values.size()*nfields);
+}
+
+template <typename V>
+uint32_t encode_vector(serializer& ser, uint32_t parent, const V& values) {
+	using T = typename V::value_type;
+	uint32_t cont = ser.add_container(parent);
+
+	// deduplication needs every entity to go through add_ent(), so the
+	// bulk path is only taken without it
+	if constexpr (is_flat<T>()) {
+		if (!ser.dedup) {
+			encode_flat(ser, cont, values);
+			return cont;
+		}
+	}
+
+	for (const T& value : values) {
+		encode_value(ser, cont, value);
+	}
+
+	return cont;
+}
+
+template <typename T>
+uint32_t encode_value(serializer& ser, uint32_t parent, const T& value) {
+	if constexpr (is_bound<T>::value) {
+		uint32_t map = ser.add_map(parent);
+
+		std::apply([&](const auto&... f) {
+			((ser.add_symbol(map, f.hash), encode_value(ser, map, value.*(f.member))), ...);
+		}, binding<T>::fields);
+
+		return map;
+
+	} else if constexpr (is_vector<T>::value) {
+		return encode_vector(ser, parent, value);
+
+	} else if constexpr (std::is_same_v<T, std::string>) {
+		return ser.add_string(parent, value);
+
+	} else {
+		static_assert(is_scalar_field<T>(), "type has no binding");
+		check_scalar_width<T>();
+		return ser.add_integer(parent, (uint32_t)value);
+	}
+}
+
+// raw entity access for the decoders
+struct raw_reader {
+	const uint32_t *datas;
+	size_t entities;
+	ent_order order;
+
+	uint32_t type(uint32_t id) const { return load_word(datas[2*id], order) >> 29; }
+	uint32_t parent(uint32_t id) const { return load_word(datas[2*id], order) & ~(7 << 29); }
+	uint32_t data(uint32_t id) const { return load_word(datas[2*id + 1], order); }
+
+	// one past the end of the subtree at 'id', which is assumed to be
+	// written in one go, like encode() and add_entities() do
+	uint32_t skip(uint32_t id) const {
+		uint32_t end = id + 1;
+
+		while (end < entities && parent(end) >= id && parent(end) < end) {
+			end++;
+		}
+
+		return end;
+	}
+
+	// whether 'anc' is on the parent chain of 'id', or is 'id'
+	bool is_ancestor(uint32_t anc, uint32_t id) const {
+		while (id > anc && parent(id) < id) {
+			id = parent(id);
+		}
+
+		return id == anc;
+	}
+};
+
+// decodes the subtree at 'id' into 'out', returns the end of the subtree.
+// 'ok' is cleared on type mismatches, fields missing from the input are
+// left alone.
+template <typename T>
+uint32_t decode_value(const raw_reader& r, uint32_t id, T& out, bool& ok) {
+	if (id >= r.entities) {
+		ok = false;
+		return id;
+	}
+
+	uint32_t type = r.type(id);
+
+	if (type == ENT_TYPE_REF) {
+		// a reference into its own ancestors would decode forever
+		if (r.data(id) >= id || r.is_ancestor(r.data(id), id)) {
+			ok = false;
+		} else {
+			decode_value(r, r.data(id), out, ok);
+		}
+
+		return r.skip(id);
+	}
+
+	if constexpr (is_bound<T>::value) {
+		if (type != ENT_TYPE_MAP) {
+			ok = false;
+			return r.skip(id);
+		}
+
+		uint32_t j = id + 1;
+
+		while (j < r.entities && r.parent(j) == id) {
+			uint32_t hash = r.data(j);
+			j = r.skip(j);
+
+			if (j >= r.entities || r.parent(j) != id) {
+				break;
+			}
+
+			// comparisons against compile-time hashes, stopping at
+			// the first match
+			bool matched = std::apply([&](const auto&... f) {
+				return ((f.hash == hash
+				         && (j = decode_value(r, j, out.*(f.member), ok), true)) || ...);
+			}, binding<T>::fields);
+
+			if (!matched) {
+				j = r.skip(j);
+			}
+		}
+
+		return j;
+
+	} else if constexpr (is_vector<T>::value) {
+		if (type != ENT_TYPE_CONTAINER) {
+			ok = false;
+			return r.skip(id);
+		}
+
+		uint32_t j = id + 1;
+		out.clear();
+
+		while (j < r.entities && r.parent(j) == id) {
+			out.emplace_back();
+			j = decode_value(r, j, out.back(), ok);
+		}
+
+		return j;
+
+	} else if constexpr (std::is_same_v<T, std::string>) {
+		if (type != ENT_TYPE_STRING) {
+			ok = false;
+			return r.skip(id);
+		}
+
+		uint32_t j = id + 1;
+		out.clear();
+
+		for (; j < r.entities && r.parent(j) == id; j++) {
+			out += r.data(j);
+		}
+
+		return j;
+
+	} else {
+		static_assert(is_scalar_field<T>(), "type has no binding");
+
+		if (type != ENT_TYPE_INTEGER && type != ENT_TYPE_SYMBOL) {
+			ok = false;
+		} else {
+			out = (T)r.data(id);
+		}
+
+		return r.skip(id);
+	}
+}
+
+// namespace detail
+}
+
+// writes a value under 'parent' and adds its field names to the symbol
+// table, returns the ID of the new top entity. vectors of structs with only
+// scalar fields are laid out in bulk, without going through add_ent().
+template <typename T>
+uint32_t encode(serializer& ser, uint32_t parent, const T& value) {
+	detail::add_symbols<T>(ser);
+	return detail::encode_value(ser, parent, value);
+}
+
+// reads the subtree at 'id' straight from serialized entities, the byte
+// order is detected from the buffer. returns false if the input doesn't
+// match the type, in which case 'out' may be partly filled in.
+template <typename T>
+bool decode(const uint32_t *datas, size_t entities, uint32_t id, T& out) {
+	detail::raw_reader r = {datas, entities, detect_order(datas, entities)};
+	bool ok = true;
+
+	detail::decode_value(r, id, out, ok);
+	return ok;
+}
+
+template <typename T>
+bool decode(const std::vector<uint32_t>& datas, uint32_t id, T& out) {
+	return decode(datas.data(), datas.size() / 2, id, out);
+}
+
+// namespace anserial
+}
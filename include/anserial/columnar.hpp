@@ -0,0 +1,53 @@
+// column-split block layout
+//
+// the regular layout interleaves (type, absolute parent, data) for every
+// entity, and absolute parent IDs grow monotonically, so general-purpose
+// compressors never see repeated patterns. this layout groups entities into
+// fixed-size blocks, and stores each block as three separate columns:
+//
+//   word 0:     COLUMN_BLOCK_MAGIC
+//   word 1:     number of entities in the block
+//   word 2:     ID of the first entity in the block
+//   types:      one byte per entity, padded out to a whole word
+//   deltas:     one word per entity, (entity ID - parent ID)
+//   datas:      one word per entity, same as the regular data word
+//
+// all words are stored in network byte order, like the regular layout.
+// note that the magic can't be mistaken for the first entity of a regular
+// stream, since the root entity always has a parent ID of 0.
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace anserial {
+
+// "anC1"
+static const uint32_t COLUMN_BLOCK_MAGIC = 0x616e4331;
+static const uint32_t COLUMN_BLOCK_ENTITIES = 1024;
+static const uint32_t COLUMN_BLOCK_HEADER = 3;
+
+// converts interleaved entities into column blocks, 'order' is the byte
+// order of the input, the blocks are always in network byte order
+std::vector<uint32_t> columnar_encode(const uint32_t *datas, size_t entities,
+                                      ent_order order = ORDER_NETWORK);
+std::vector<uint32_t> columnar_encode(const std::vector<uint32_t>& datas,
+                                      ent_order order = ORDER_NETWORK);
+
+// decodes one column block into interleaved entities in network byte
+// order, appended to 'out'.
+// returns the number of words consumed from 'block', throws
+// std::invalid_argument if the block is malformed.
+size_t columnar_decode_block(const uint32_t *block, size_t words,
+                             std::vector<uint32_t>& out);
+
+// decodes a sequence of column blocks back into interleaved entities
+std::vector<uint32_t> columnar_decode(const uint32_t *blocks, size_t words);
+
+// true if the buffer starts with a column block
+bool is_columnar(const uint32_t *datas, size_t words);
+
+// namespace anserial
+}
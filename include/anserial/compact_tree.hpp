@@ -0,0 +1,95 @@
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <anserial/symbol_table.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace anserial {
+
+// non-virtual, 16 byte alternative to s_node. nodes live in one array inside
+// a compact_tree and refer to each other by entity ID, children of a node
+// are a contiguous range in the tree's child index, and string characters
+// are a contiguous range in the tree's string pool.
+class compact_node {
+	public:
+		uint32_t type(void) const { return tag >> 29; }
+		uint32_t parent(void) const { return tag & ~(7 << 29); }
+
+		// type << 29 | parent ID, same as the first serialized word
+		uint32_t tag;
+		uint32_t data;
+		// start and length of the child range, or of the string for strings
+		uint32_t first;
+		uint32_t count;
+};
+
+static_assert(sizeof(compact_node) == 16, "compact_node should stay 16 bytes");
+
+// immutable tree of compact_nodes, built straight from serialized entities.
+// accessors switch on the node type and return compact_tree::npos (or an
+// empty value) on mismatches instead of throwing, so they're cheap to use
+// for probing. navigation mirrors s_tree. nothing changes after construction,
+// so any number of threads can read from a compact_tree at once.
+class compact_tree {
+	public:
+		static const uint32_t npos = ~0u;
+
+		// the byte order is detected from the buffer, see detect_order()
+		compact_tree(const uint32_t *datas, size_t entities);
+		compact_tree(const uint32_t *datas, size_t entities, ent_order order);
+		compact_tree(const std::vector<uint32_t>& datas);
+
+		size_t size(void) const { return nodes.size(); }
+		const compact_node& node(uint32_t id) const { return nodes[id]; }
+
+		// type of a node, or ENT_TYPE_NULL for invalid IDs
+		uint32_t type(uint32_t id) const {
+			return (id < nodes.size())? nodes[id].type() : (uint32_t)ENT_TYPE_NULL;
+		}
+
+		// number of children, for maps this counts values (not keys)
+		uint32_t count(uint32_t id) const;
+
+		// n'th child of a container, or n'th value of a map
+		uint32_t get(uint32_t id, uint32_t index) const;
+		// n'th key of a map
+		uint32_t key(uint32_t id, uint32_t index) const;
+		// map lookup by symbol
+		uint32_t get(uint32_t id, const std::string& symbol) const;
+		uint32_t get_hash(uint32_t id, uint32_t hash) const;
+
+		// data of integers and symbols
+		bool uint(uint32_t id, uint32_t& out) const;
+		// characters of a string, empty for anything else
+		std::string_view string(uint32_t id) const;
+
+		// metadata accessors, like s_tree
+		uint32_t top(void) const { return nodes.empty()? npos : 0; }
+		uint32_t data(void) const;
+		uint32_t lookup(uint32_t hash) const;
+		const symbol_table& symbols(void) const { return syms; }
+
+		void dump_nodes(void) const;
+		void dump_nodes(uint32_t id, unsigned indent = 0) const;
+
+	private:
+		void build(const uint32_t *datas, size_t entities, ent_order order);
+
+		std::vector<compact_node> nodes;
+		std::vector<uint32_t> children;
+		std::string pool;
+		symbol_table syms;
+
+		struct {
+			uint32_t symtab;
+			uint32_t version;
+			uint32_t data;
+		} cached = {npos, npos, npos};
+};
+
+// namespace anserial
+}
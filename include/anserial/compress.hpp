@@ -0,0 +1,87 @@
+// compressed container format
+//
+// the serialized output is split into blocks of whole entities, and each
+// block is compressed on its own with a small LZ codec, so blocks can be
+// decompressed independently (and in parallel), and a reader can seek
+// straight to the block holding some entity. each block starts with a
+// header of four words in network byte order:
+//
+//   word 0:     COMPRESSED_BLOCK_MAGIC
+//   word 1:     ID of the first entity in the block
+//   word 2:     number of entities in the block
+//   word 3:     payload size in bytes, COMPRESSED_BLOCK_STORED is set if
+//               the payload is the raw entities
+//
+// payloads are padded to a multiple of 4 bytes, so headers stay aligned.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace anserial {
+
+// "anZ1"
+static const uint32_t COMPRESSED_BLOCK_MAGIC = 0x616e5a31;
+static const uint32_t COMPRESSED_BLOCK_ENTITIES = 8192;
+static const uint32_t COMPRESSED_BLOCK_STORED = 1u << 31;
+static const uint32_t COMPRESSED_BLOCK_HEADER = 16;
+
+// raw LZ codec, used for block payloads.
+// lz_decompress() returns the number of bytes written to 'out', and throws
+// std::invalid_argument if the input is corrupt or doesn't fit in 'out'.
+void lz_compress(const uint8_t *in, size_t len, std::vector<uint8_t>& out);
+size_t lz_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_len);
+
+// compresses entities into a sequence of blocks
+std::vector<uint8_t> compress_entities(const uint32_t *datas, size_t entities,
+                                       uint32_t block_entities = COMPRESSED_BLOCK_ENTITIES);
+std::vector<uint8_t> compress_entities(const std::vector<uint32_t>& datas,
+                                       uint32_t block_entities = COMPRESSED_BLOCK_ENTITIES);
+
+// true if the buffer starts with a compressed block. like column blocks,
+// this can't be confused with the first entity of a regular stream.
+bool is_compressed(const uint8_t *buf, size_t len);
+
+class compressed_reader {
+	public:
+		struct block_info {
+			uint32_t first_entity;
+			uint32_t entities;
+			// offset of the payload in the input buffer
+			size_t offset;
+			uint32_t payload;
+			bool stored;
+		};
+
+		// scans block headers, the buffer must outlive the reader.
+		// blocks holding more than 'max_entities' in total throw
+		// std::length_error, before anything is allocated for them.
+		compressed_reader(const uint8_t *buf, size_t len,
+		                  size_t max_entities = SIZE_MAX);
+
+		// number of entities across all blocks
+		size_t entities() const { return total; }
+		const std::vector<block_info>& blocks() const { return index; }
+
+		// returns the index of the block holding an entity, or
+		// blocks().size() if there is none
+		size_t find_block(uint32_t entity) const;
+
+		// decompresses one block into 'out', which must have room
+		// for 2*entities words
+		void decompress_block(size_t i, uint32_t *out) const;
+
+		// decompresses everything, splitting blocks across threads.
+		// 0 threads means one per hardware thread, and there are never
+		// more threads than blocks.
+		std::vector<uint32_t> decompress(unsigned threads = 0) const;
+
+	private:
+		const uint8_t *input;
+		size_t total = 0;
+		std::vector<block_info> index;
+};
+
+// namespace anserial
+}
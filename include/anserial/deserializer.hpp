@@ -3,14 +3,46 @@
 #include <anserial/base_ent.hpp>
 #include <anserial/s_node.hpp>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 namespace anserial {
 
+// "anK1"
+static const uint32_t CHECKPOINT_MAGIC = 0x616e4b31;
+
+// callbacks fired by a deserializer as entities arrive, see
+// deserializer::events. each one gets the parent and ID of the entity,
+// the defaults do nothing, so only override what's needed.
+class deserializer_events {
+	public:
+		virtual ~deserializer_events() {}
+
+		virtual void on_container(uint32_t parent, uint32_t id) {}
+		virtual void on_map(uint32_t parent, uint32_t id) {}
+		virtual void on_set(uint32_t parent, uint32_t id) {}
+		virtual void on_null(uint32_t parent, uint32_t id) {}
+
+		// keys of a map are reported here instead of as symbols,
+		// values are reported normally
+		virtual void on_map_key(uint32_t parent, uint32_t id, uint32_t symbol) {}
+		virtual void on_symbol(uint32_t parent, uint32_t id, uint32_t symbol) {}
+		virtual void on_integer(uint32_t parent, uint32_t id, uint32_t value) {}
+
+		// fired once the characters of a string are all in, which is when
+		// any other entity arrives or on deserializer::finish(). the
+		// serializer always writes characters right after their string,
+		// anything arriving later is reported with on_integer().
+		virtual void on_string_complete(uint32_t parent, uint32_t id,
+		                                const std::string& str) {}
+
+		virtual void on_ref(uint32_t parent, uint32_t id, uint32_t target) {}
+};
+
 class deserializer {
 	public:
 		deserializer() {};
-		deserializer(uint32_t *datas, size_t entities) {
+		deserializer(const uint32_t *datas, size_t entities) {
 			deserialize(datas, entities);
 		}
 
@@ -18,18 +50,120 @@ class deserializer {
 			deserialize(datas);
 		}
 
-		// used for decoding
+		// node of each entity, used for decoding. string characters are
+		// appended to their string instead of getting a node, so they're
+		// nullptr here, as is anything under them. stays empty while
+		// 'build_nodes' is cleared.
 		std::vector<s_node*> nodes;
 
 		// last assigned entity ID
 		uint32_t ent_counter = 0;
 
+		// byte order of the input. when 'detect' is set, this is
+		// guessed from the first entity, see detect_order()
+		ent_order order = ORDER_NETWORK;
+		bool detect = true;
+
+		// caps on what the deserializer will build, 0 means unlimited.
+		// crossing any of them throws std::length_error from deserialize().
+		struct {
+			size_t max_bytes = 0;
+			size_t max_entities = 0;
+			uint32_t max_depth = 0;
+		} limits;
+
+		// estimated memory used by the nodes built so far, and the peak
+		// of that. this counts node objects, the vectors and map entries
+		// linking them, and string storage, plus a guess at malloc overhead.
+		size_t bytes_allocated = 0;
+		size_t peak_bytes = 0;
+
+		double bytes_per_entity() const;
+
+		// when set, callbacks are fired for every entity added. with
+		// 'build_nodes' cleared no s_node tree is built at all, and
+		// deserialize() returns nullptr. set both before adding entities.
+		deserializer_events *events = nullptr;
+		bool build_nodes = true;
+
+		// fires any event still waiting on more input, the last string
+		void finish();
+
+		// once frozen, deserialize() throws std::logic_error instead of adding
+		// entities, so the tree can be shared with readers without locking
+		void freeze() { frozen = true; }
+		bool is_frozen() const { return frozen; }
+
 		// returns just what is already parsed
 		s_node *deserialize();
 
 		// add entities to the deserialized tree
-		s_node *deserialize(uint32_t *datas, size_t entities);
+		s_node *deserialize(const uint32_t *datas, size_t entities);
 		s_node *deserialize(std::vector<uint32_t> datas);
+
+		// add entities from column-split blocks, see columnar.hpp.
+		// blocks are expected in order, starting at the current entity counter
+		s_node *deserialize_columnar(const uint32_t *blocks, size_t words);
+
+		// add entities from compressed blocks, see compress.hpp. blocks are
+		// decompressed in parallel, 0 threads means one per hardware thread.
+		// the limits are checked against the block headers first, counting
+		// 8 bytes per entity for the decompressed buffer.
+		s_node *deserialize_compressed(const uint8_t *buf, size_t len,
+		                               unsigned threads = 0);
+
+		// saves what's been decoded so far, so a long ingest can pick up
+		// where it left off after a crash. 'input_offset' is stored along
+		// with it, for the caller to know where to resume reading. the
+		// entities are rebuilt from the nodes, so a checkpoint costs about
+		// as much as serializing the tree, and is stored compressed. when
+		// only firing events, just the per-entity event state is saved.
+		std::vector<uint8_t> checkpoint(uint64_t input_offset = 0) const;
+
+		// rebuilds the state saved by checkpoint() in an empty deserializer,
+		// decompressing in parallel like deserialize_compressed(). events
+		// aren't fired for restored entities. 'events' and 'build_nodes'
+		// have to be set up the same way as when the checkpoint was taken,
+		// std::logic_error is thrown otherwise. returns the input offset
+		// given to checkpoint(), throws std::invalid_argument if the
+		// buffer isn't a checkpoint.
+		uint64_t restore(const uint8_t *buf, size_t len, unsigned threads = 0);
+		uint64_t restore(const std::vector<uint8_t>& buf, unsigned threads = 0) {
+			return restore(buf.data(), buf.size(), threads);
+		}
+
+	private:
+		template <ent_order O>
+		void deserialize_range(const uint32_t *datas, size_t entities);
+		void account(size_t bytes);
+		size_t entity_budget() const;
+		void push_depth(uint32_t depth);
+		void emit(const s_ent& entity);
+		void flush_string();
+		// brings ev_types in line with the entity counter, from the nodes
+		// if there are any, for entities added while no events were fired
+		void sync_event_types();
+
+		// per-allocation overhead of a typical malloc, and the size of
+		// a std::map node holding a map entry
+		static const size_t ALLOC_OVERHEAD = 16;
+		static const size_t MAP_NODE_SIZE = 48 + ALLOC_OVERHEAD;
+
+		// depth of each entity, for limits.max_depth
+		std::vector<uint32_t> depths;
+		bool frozen = false;
+
+		// type of each entity, only kept when firing events. for maps,
+		// bit 3 is set when the next child is a value rather than a key
+		std::vector<uint8_t> ev_types;
+
+		// string still collecting characters for on_string_complete()
+		struct {
+			bool open = false;
+			uint32_t id;
+			uint32_t parent;
+			std::string str;
+		} pending;
 };
 
 // namespace anserial
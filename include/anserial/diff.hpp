@@ -0,0 +1,59 @@
+// binary diffs between documents
+//
+// make_patch() compares two serialized documents and writes what changed as
+// another anserial document:
+//
+//   (map
+//       ::version (...)
+//       ::patch (map
+//           base      base-entities
+//           base-hash (container hash-hi hash-lo)
+//           entities  target-entities
+//           order     target-byte-order)
+//       ::symtab (...)
+//       ::ops (container
+//           src len                                  ; copy from the base
+//           (container tag data tag data ...)        ; literal entities
+//           ...))
+//
+// runs of entities are matched structurally rather than byte for byte: a
+// run copied from the base keeps its shape, parents inside the run move
+// along with it, and parents before it go to wherever that parent was
+// copied. so a record still matches after things are inserted or removed
+// in front of it, even though its parent ID is now different. candidate
+// runs are found by hashing windows of the base and rolling a hash over
+// the target, like rsync does, and then extended as far as they go in both
+// directions. literal entities are stored with parents (and reference
+// targets) relative to their own ID.
+//
+// applying a patch is mostly copying runs of the base while fixing up
+// parent IDs, so it's about as fast as copying the document.
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace anserial {
+
+// entities per hashed window, runs shorter than this aren't looked for
+static const size_t PATCH_WINDOW = 16;
+
+// the byte orders of both documents are detected, the patch is written in
+// network order
+std::vector<uint32_t> make_patch(const uint32_t *base, size_t base_entities,
+                                 const uint32_t *target, size_t target_entities);
+std::vector<uint32_t> make_patch(const std::vector<uint32_t>& base,
+                                 const std::vector<uint32_t>& target);
+
+// rebuilds the target document, byte for byte. throws std::invalid_argument
+// if the patch was made against a different base, and std::runtime_error
+// if the patch is malformed.
+std::vector<uint32_t> apply_patch(const uint32_t *base, size_t base_entities,
+                                  const uint32_t *patch, size_t patch_entities);
+std::vector<uint32_t> apply_patch(const std::vector<uint32_t>& base,
+                                  const std::vector<uint32_t>& patch);
+
+// namespace anserial
+}
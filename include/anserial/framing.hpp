@@ -0,0 +1,84 @@
+// message framing for pipes and sockets
+//
+// every frame starts with an 8 byte header of big endian words,
+//
+//   [FRAME_MAGIC << 16 | type] [entities]
+//
+// followed by the serialized entities. the type is free for applications
+// to use, eg. to tell message kinds apart before decoding anything.
+#pragma once
+
+#include <anserial/serializer.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace anserial {
+
+// "aN"
+static const uint32_t FRAME_MAGIC = 0x614e;
+static const size_t FRAME_HEADER = 8;
+
+// batches frames up and sends them with as few writev() calls as possible
+class frame_writer {
+	public:
+		frame_writer(int nfd) : fd(nfd) {}
+
+		// queues a frame without copying it, so the data has to stay
+		// valid until the next flush()
+		void queue(const uint32_t *datas, size_t entities, uint16_t type = 0);
+		void queue(const serializer& ser, uint16_t type = 0);
+
+		// writes out everything queued, throws std::runtime_error on errors
+		void flush(void);
+
+		void send(const uint32_t *datas, size_t entities, uint16_t type = 0) {
+			queue(datas, entities, type);
+			flush();
+		}
+
+		size_t pending(void) const { return frames.size(); }
+
+	private:
+		struct queued {
+			const uint32_t *datas;
+			size_t entities;
+		};
+
+		int fd;
+		std::vector<queued> frames;
+		std::vector<uint32_t> headers;
+};
+
+// reads frames into one reusable buffer, in reads as large as the buffer
+// allows, and hands out complete frames in place
+class frame_reader {
+	public:
+		struct frame {
+			uint16_t type;
+			const uint32_t *datas;
+			size_t entities;
+		};
+
+		frame_reader(int nfd, size_t buffer_size = 1 << 16);
+
+		// frames larger than this throw std::length_error, rather than
+		// growing the buffer to whatever a peer claims
+		size_t max_entities = 1 << 24;
+
+		// next complete frame, or false at the end of input. the frame
+		// points into the buffer and stays valid until the next call.
+		// throws std::runtime_error on read errors, bad headers and
+		// input ending partway through a frame.
+		bool next(frame& out);
+
+	private:
+		int fd;
+		std::vector<uint32_t> buffer;
+		// valid bytes in the buffer
+		size_t start = 0;
+		size_t end = 0;
+};
+
+// namespace anserial
+}
@@ -0,0 +1,81 @@
+// seekable index footer
+//
+// serializer::add_index() writes an "::index" entry to the top-level map,
+// after everything else:
+//
+//   ::index (container
+//       (container key-hash value-id value-end ...)   ; top-level map values
+//       (container record-id record-end ...)          ; children of ::data
+//       INDEX_MAGIC)
+//
+// ends are one past the last entity of a subtree. the magic integer is the
+// last entity of the stream, so a reader can find the index from the end
+// of a file and decode only the subtrees it needs.
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <anserial/mapped_file.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace anserial {
+
+// "anI1"
+static const uint32_t INDEX_MAGIC = 0x616e4931;
+
+// random access to subtrees of a stream with an index footer. nothing is
+// copied or decoded up front besides the index itself, so the buffer can be
+// a mapped_file, and looking up a record costs O(record) rather than
+// O(file). subtrees are returned as standalone network order streams, ready
+// for a deserializer or compact_tree.
+class indexed_reader {
+	public:
+		static const uint32_t npos = ~0u;
+
+		// throws std::runtime_error if there's no valid index at the end
+		indexed_reader(const uint32_t *datas, size_t entities);
+		indexed_reader(mapped_file& file);
+
+		// number of records, children of ::data
+		size_t records(void) const { return record_ranges.size(); }
+
+		// entity ID and end of a record or top-level value, npos if missing
+		uint32_t record_id(size_t n) const;
+		uint32_t entry_id(const std::string& key) const;
+
+		// decode just one subtree
+		std::vector<uint32_t> record(size_t n) const;
+		std::vector<uint32_t> entry(const std::string& key) const;
+		std::vector<uint32_t> symtab(void) const { return entry("::symtab"); }
+
+		// copies the subtree at 'id' into a new stream, with IDs renumbered
+		// from 0. entities in [id, end) that aren't descendants of 'id' are
+		// skipped. references pointing outside of the subtree are replaced
+		// with a copy of their target, which means scanning from the
+		// target to the reference.
+		std::vector<uint32_t> extract(uint32_t id, uint32_t end) const;
+
+	private:
+		struct range {
+			uint32_t id;
+			uint32_t end;
+		};
+
+		void load(void);
+		uint32_t tag(uint32_t id) const { return load_word(datas[2*id], order); }
+		uint32_t data(uint32_t id) const { return load_word(datas[2*id + 1], order); }
+		uint32_t copy_subtree(uint32_t root, uint32_t end, uint32_t new_parent,
+		                      std::vector<uint32_t>& out) const;
+
+		const uint32_t *datas;
+		size_t entities;
+		ent_order order;
+
+		std::vector<std::pair<uint32_t, range>> top_ranges;
+		std::vector<range> record_ranges;
+};
+
+// namespace anserial
+}
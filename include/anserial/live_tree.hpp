@@ -0,0 +1,122 @@
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace anserial {
+
+// storage shared between a live_tree and its snapshots. entities are kept
+// in fixed-size chunks which are never moved or freed while anything still
+// refers to them, and children are linked in ID order, so appending an
+// entity never changes anything a reader of an older snapshot can see.
+class live_storage {
+	public:
+		static const uint32_t npos = ~0u;
+		static const unsigned CHUNK_BITS = 16;
+		static const uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+		// parent IDs are 29 bits, so this covers every possible entity
+		static const uint32_t MAX_CHUNKS = (1u << 29) >> CHUNK_BITS;
+
+		struct record {
+			// type << 29 | parent, and data, same as the serialized entity
+			uint32_t tag;
+			uint32_t data;
+			// child links, written by the writer while readers may be
+			// following them, so these need to be atomic
+			std::atomic<uint32_t> first_child;
+			std::atomic<uint32_t> next_sibling;
+			// only used by the writer
+			uint32_t last_child;
+		};
+
+		live_storage();
+		~live_storage();
+
+		record& at(uint32_t id) const {
+			return chunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)
+			       [id & (CHUNK_SIZE - 1)];
+		}
+
+		std::unique_ptr<std::atomic<record*>[]> chunks;
+		// number of entities visible to new snapshots
+		std::atomic<uint32_t> published;
+};
+
+// consistent, read-only view of a live_tree at the time it was taken.
+// entities added afterwards are invisible to it, and it keeps the storage
+// alive on its own, so it can outlive the tree. accessors return npos or
+// empty values instead of throwing, and follow references transparently.
+class live_snapshot {
+	public:
+		static const uint32_t npos = live_storage::npos;
+
+		live_snapshot() {}
+		live_snapshot(std::shared_ptr<const live_storage> nstore, uint32_t ncount)
+			: store(std::move(nstore)), count(ncount) {}
+
+		size_t size(void) const { return count; }
+
+		uint32_t type(uint32_t id) const;
+		uint32_t parent(uint32_t id) const;
+		bool uint(uint32_t id, uint32_t& out) const;
+		std::string string(uint32_t id) const;
+
+		// child iteration, npos when there are no more children
+		uint32_t first_child(uint32_t id) const;
+		uint32_t next_sibling(uint32_t id) const;
+
+		// n'th child of a container, or n'th value of a map
+		uint32_t get(uint32_t id, uint32_t index) const;
+		// map lookup by symbol
+		uint32_t get(uint32_t id, const std::string& symbol) const;
+		uint32_t get_hash(uint32_t id, uint32_t hash) const;
+
+		// metadata accessors, like s_tree
+		uint32_t top(void) const { return count? 0 : npos; }
+		uint32_t data(void) const;
+		uint32_t lookup(uint32_t hash) const;
+
+	private:
+		// follows references to the entity they point at
+		uint32_t resolve(uint32_t id) const;
+		uint32_t visible(uint32_t id) const { return (id < count)? id : npos; }
+
+		std::shared_ptr<const live_storage> store;
+		uint32_t count = 0;
+};
+
+// versioned tree for serving data while it's still arriving. a single
+// writer thread feeds entities in with deserialize(), and any number of
+// reader threads take O(1) snapshots, without either side blocking.
+class live_tree {
+	public:
+		live_tree();
+
+		// byte order of the input, see deserializer
+		ent_order order = ORDER_NETWORK;
+		bool detect = true;
+
+		// writer side, only one thread may call this at a time. throws
+		// std::out_of_range for invalid parent or reference IDs, after
+		// publishing whatever came before the bad entity.
+		void deserialize(const uint32_t *datas, size_t entities);
+		void deserialize(const std::vector<uint32_t>& datas);
+
+		// reader side, safe to call from any thread
+		live_snapshot snapshot(void) const;
+
+		size_t size(void) const { return ent_counter; }
+
+	private:
+		std::shared_ptr<live_storage> store;
+		// writer-side count, may be ahead of store->published
+		uint32_t ent_counter = 0;
+};
+
+// namespace anserial
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+namespace anserial {
+
+// memory-mapped view of a file, so serialized data can be read (or updated
+// in place) without copying it into a buffer first
+class mapped_file {
+	public:
+		// throws std::runtime_error if the file can't be opened or mapped
+		mapped_file(const std::string& path, bool writable = false);
+		~mapped_file();
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		uint8_t *data() { return addr; }
+		const uint8_t *data() const { return addr; }
+		size_t size() const { return length; }
+
+		// entity-sized accessors, any trailing partial entity is ignored
+		uint32_t *words() { return (uint32_t*)addr; }
+		size_t entities() const { return length / 8; }
+
+		// flush changes back to the file
+		void sync();
+
+	private:
+		int fd = -1;
+		uint8_t *addr = nullptr;
+		size_t length = 0;
+		bool writable;
+};
+
+// namespace anserial
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <anserial/serializer.hpp>
+#include <anserial/mapped_file.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace anserial {
+
+// in-place access to a serialized buffer. every entity is 8 bytes at
+// offset 8*id, so once an entity is resolved its data word can be
+// overwritten directly, without deserializing or re-serializing anything.
+// the buffer must outlive the view.
+class mutable_view {
+	public:
+		// the byte order is detected from the buffer, see detect_order()
+		mutable_view(uint32_t *datas, size_t entities);
+		mutable_view(uint32_t *datas, size_t entities, ent_order order);
+		mutable_view(mapped_file& file);
+
+		struct update {
+			uint32_t id;
+			uint32_t value;
+		};
+
+		size_t size() const { return count; }
+
+		// raw entity fields
+		uint32_t type(uint32_t id) const;
+		uint32_t parent(uint32_t id) const;
+		uint32_t data(uint32_t id) const;
+
+		// child lookups, these throw std::out_of_range if there's no match.
+		// for maps, child() indexes values, skipping keys.
+		uint32_t child(uint32_t id, uint32_t index) const;
+		uint32_t lookup(uint32_t id, const std::string& key) const;
+		uint32_t lookup(uint32_t id, uint32_t hash) const;
+
+		// follows a path of map keys (symbols) and child indexes (integers)
+		// starting from 'from', eg. resolve({"::data", 1u, "count"})
+		uint32_t resolve(const std::vector<ent_int>& path, uint32_t from = 0) const;
+
+		// overwrites the value of an integer entity, throws std::logic_error
+		// if the entity isn't an integer. in buffers written with
+		// serializer::dedup, the entity may be part of a subtree that
+		// references point to, which then all see the new value as well.
+		void set_uint(uint32_t id, uint32_t value);
+		// checks every update first, so either all of them are written or none
+		void apply(const std::vector<update>& updates);
+
+		// builds a child index over the whole buffer, so lookups cost
+		// O(children) rather than a scan of everything after the parent.
+		// worth it when resolving many paths.
+		void index_children();
+
+	private:
+		// calls fn(child ID) for each child of 'id' until it returns true,
+		// returns the matching child or NO_ENTITY
+		template <typename F>
+		uint32_t find_child(uint32_t id, F fn) const;
+
+		uint32_t *words;
+		size_t count;
+		ent_order order;
+
+		// child index, built by index_children()
+		std::vector<uint32_t> child_start;
+		std::vector<uint32_t> child_ids;
+
+		static const uint32_t NO_ENTITY = ~0u;
+};
+
+// namespace anserial
+}
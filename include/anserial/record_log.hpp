@@ -0,0 +1,132 @@
+// append-only record log
+//
+// a log file holds independent serialized documents, each one behind a
+// 16 byte frame header of big endian words:
+//
+//   [LOG_FRAME_MAGIC] [entities] [timestamp high] [timestamp low]
+//
+// followed by the entities as the serializer wrote them, in either byte
+// order. a side index at <path>.idx has one 16 byte entry per record,
+// [offset high] [offset low] [timestamp high] [timestamp low], so records
+// can be found by number in O(1), and by timestamp with a binary search.
+// timestamps are whatever the caller wants, but must not decrease.
+//
+// records are written before their index entry, so after a crash the log
+// may be ahead of the index. the writer catches the index up (and drops a
+// partially written record) when it's opened, and readers scan past the
+// end of the index themselves.
+//
+// a writer holds an exclusive flock() on its log for as long as it's open,
+// so there's only ever one, and compact_log() refuses to run under it.
+#pragma once
+
+#include <anserial/mapped_file.hpp>
+#include <anserial/serializer.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace anserial {
+
+// "anR1"
+static const uint32_t LOG_FRAME_MAGIC = 0x616e5231;
+static const size_t LOG_FRAME_HEADER = 16;
+static const size_t LOG_INDEX_ENTRY = 16;
+
+class record_log_writer {
+	public:
+		// opens or creates the log and its index, throws std::runtime_error
+		// if either can't be opened, the log is corrupt or another writer
+		// has it open
+		record_log_writer(const std::string& path);
+		~record_log_writer();
+
+		record_log_writer(const record_log_writer&) = delete;
+		record_log_writer& operator=(const record_log_writer&) = delete;
+
+		// returns the new record's number. throws std::invalid_argument if
+		// the timestamp is older than the last record's
+		uint64_t append(const uint32_t *datas, size_t entities, uint64_t timestamp);
+		uint64_t append(const serializer& ser, uint64_t timestamp);
+
+		uint64_t records(void) const { return count; }
+
+		// flush both files to disk
+		void sync(void);
+
+	private:
+		void recover(void);
+		void write_all(int fd, const void *buf, size_t len);
+
+		std::string path;
+		int log_fd = -1;
+		int idx_fd = -1;
+
+		uint64_t count = 0;
+		uint64_t log_size = 0;
+		uint64_t last_timestamp = 0;
+};
+
+// read-only, zero copy view of a log. records point straight into the
+// mapped file, so they stay valid as long as the record_log does.
+class record_log {
+	public:
+		struct record {
+			const uint32_t *datas;
+			size_t entities;
+			uint64_t timestamp;
+		};
+
+		class iterator {
+			public:
+				iterator(const record_log *nlog, size_t npos) : log(nlog), pos(npos) {}
+
+				record operator*() const { return log->get(pos); }
+				iterator& operator++() { pos++; return *this; }
+				bool operator!=(const iterator& other) const { return pos != other.pos; }
+
+			private:
+				const record_log *log;
+				size_t pos;
+		};
+
+		// throws std::runtime_error if the log can't be opened or is corrupt
+		record_log(const std::string& path);
+
+		size_t size(void) const { return indexed + tail.size(); }
+
+		// throws std::out_of_range for records past the end
+		record get(size_t n) const;
+		// first record with a timestamp at or after 'timestamp', or size()
+		size_t find(uint64_t timestamp) const;
+
+		iterator begin(void) const { return iterator(this, 0); }
+		iterator end(void) const { return iterator(this, size()); }
+
+	private:
+		struct entry {
+			uint64_t offset;
+			uint64_t timestamp;
+		};
+
+		entry index_entry(size_t n) const;
+		bool valid_frame(uint64_t offset, uint64_t timestamp) const;
+
+		std::unique_ptr<mapped_file> log;
+		std::unique_ptr<mapped_file> idx;
+
+		// records in the index, and any found after it
+		size_t indexed = 0;
+		std::vector<entry> tail;
+};
+
+// rewrites a log without the records older than 'before', and rebuilds its
+// index. the new files replace the old ones with rename(), so readers that
+// already have them open keep their old view. writers have to be closed
+// first, std::runtime_error is thrown while one has the log open.
+void compact_log(const std::string& path, uint64_t before);
+
+// namespace anserial
+}
@@ -3,15 +3,19 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_set>
+#include <optional>
 #include <stdexcept>
 
 namespace anserial {
 
 // TODO: rename to different prefix so it's clear this is part of a tree class
-// TODO: make an exception-free version of this
 class s_node {
 	public:
-		virtual ~s_node() {}
+		// out of line, so the node counters (see stats.hpp) only depend
+		// on how the library was built
+		s_node();
+		virtual ~s_node();
 		virtual void link_ent(s_node* ent) {
 			// silently drop links to this node
 			// TODO: maybe provide an error message, or have linking in the
@@ -47,6 +51,23 @@ class s_node {
 			throw std::logic_error("anserial: no uint() method for type " + type());
 		};
 
+		// membership test for sets, values are integers or symbol hashes
+		virtual bool contains(uint32_t value){
+			throw std::logic_error("anserial: no contains() method for type " + type());
+		};
+
+		bool contains(const std::string& symbol) {
+			return contains(hash_string(symbol));
+		}
+
+		// exception-free versions of the accessors above, these return
+		// nullptr/std::nullopt for type mismatches and missing entries,
+		// which makes probing for optional fields cheap
+		virtual s_node* try_get(uint32_t index) { return nullptr; }
+		virtual s_node* try_get(const std::string& symbol) { return nullptr; }
+		virtual std::string* try_string() { return nullptr; }
+		virtual std::optional<uint32_t> try_uint() { return std::nullopt; }
+
 		// returns a vector reference with the list of contained entities
 		virtual std::vector<s_node*>& entities() {
 			// return an empty vector by default, so we don't
@@ -70,7 +91,7 @@ class s_node {
 		const std::string& type(void) {
 			static const std::string types[] = {
 				"container", "symbol", "integer", "string",
-				"map", "set", "null",
+				"map", "set", "null", "ref",
 			};
 
 			return types[self.d_type];
@@ -100,6 +121,10 @@ class s_container : public s_node {
 			return ents[index];
 		}
 
+		virtual s_node* try_get(uint32_t index) {
+			return (index < ents.size())? ents[index] : nullptr;
+		}
+
 		virtual void link_ent(s_node* ent) {
 			ents.push_back(ent);
 		}
@@ -114,22 +139,34 @@ class s_container : public s_node {
 class s_map : public s_node {
 	public:
 		virtual ~s_map() {
-			for (auto& x : entries) {
-				// self-recursive parents are allowed so we need to check for that here
-				if (x.second != this) {
-					delete x.second;
-				}
+			// values are deleted from the vector rather than the map, so values
+			// shadowed by a repeated key are freed too
+			for (auto& x : ents) {
+				delete x;
+			}
+
+			for (auto& x : ent_keys) {
+				delete x;
 			}
 		}
 
 		virtual s_node* get(const std::string& symbol){
-			return entries[hash_string(symbol)];
+			return get(hash_string(symbol));
 		}
 
+		// lookups never modify the map, so any number of threads can
+		// read from a tree once nothing is being added to it anymore
 		virtual s_node* get(uint32_t symbol) {
-			return entries[symbol];
+			return try_get(symbol);
+		}
+
+		// missing entries aren't errors for maps, so these are the same as get()
+		virtual s_node* try_get(const std::string& symbol) {
+			return try_get(hash_string(symbol));
 		}
 
+		virtual s_node* try_get(uint32_t symbol);
+
 		virtual void link_ent(s_node* ent) {
 			// XXX: for now, don't link to self, not sure what to do
 			//      when a map is the top-level entity since the first added
@@ -196,6 +233,10 @@ class s_string : public s_node {
 			return str;
 		}
 
+		virtual std::string* try_string() {
+			return &str;
+		}
+
 		std::string str;
 };
 
@@ -206,6 +247,113 @@ class s_uint : public s_node {
 		virtual uint32_t uint(){
 			return self.data;
 		}
+
+		virtual std::optional<uint32_t> try_uint() {
+			return self.data;
+		}
+};
+
+// unordered collection, integers and symbols in it are also kept in a hash
+// set as they're linked, so contains() doesn't need to scan the elements
+class s_set : public s_node {
+	public:
+		virtual ~s_set() {
+			for (auto& x : ents) {
+				delete x;
+			}
+		}
+
+		using s_node::contains;
+
+		virtual bool contains(uint32_t value) {
+			return members.count(value) > 0;
+		}
+
+		virtual void link_ent(s_node* ent) {
+			// same as maps, the top-level entity gets linked to itself
+			if (ent == this) {
+				return;
+			}
+
+			ents.push_back(ent);
+
+			if (ent->self.d_type == ENT_TYPE_INTEGER
+			    || ent->self.d_type == ENT_TYPE_SYMBOL)
+			{
+				members.insert(ent->self.data);
+			}
+		}
+
+		virtual std::vector<s_node*>& entities() {
+			return ents;
+		}
+
+		std::vector<s_node*> ents;
+		std::unordered_set<uint32_t> members;
+};
+
+// explicit null value, eg. for map entries with nothing in them
+class s_null : public s_node {
+	public:
+		virtual ~s_null() {}
+};
+
+// shared, read-only stand-in for a subtree that was already deserialized,
+// created for back-reference entities. the raw entity's type and data are
+// replaced with the target's so type checks see through the reference.
+class s_ref : public s_node {
+	public:
+		s_ref(s_node *node) : target(node) {}
+		// the target is owned by its own parent, not by references to it
+		virtual ~s_ref() {}
+
+		virtual s_node* get(uint32_t index) {
+			return target->get(index);
+		}
+
+		virtual s_node* get(const std::string& symbol) {
+			return target->get(symbol);
+		}
+
+		virtual std::string& string() {
+			return target->string();
+		}
+
+		virtual uint32_t uint() {
+			return target->uint();
+		}
+
+		using s_node::contains;
+
+		virtual bool contains(uint32_t value) {
+			return target->contains(value);
+		}
+
+		virtual s_node* try_get(uint32_t index) {
+			return target->try_get(index);
+		}
+
+		virtual s_node* try_get(const std::string& symbol) {
+			return target->try_get(symbol);
+		}
+
+		virtual std::string* try_string() {
+			return target->try_string();
+		}
+
+		virtual std::optional<uint32_t> try_uint() {
+			return target->try_uint();
+		}
+
+		virtual std::vector<s_node*>& entities() {
+			return target->entities();
+		}
+
+		virtual std::vector<s_node*>& keys() {
+			return target->keys();
+		}
+
+		s_node *target;
 };
 
 class s_symbol : public s_node {
@@ -215,6 +363,10 @@ class s_symbol : public s_node {
 		virtual uint32_t uint(){
 			return self.data;
 		}
+
+		virtual std::optional<uint32_t> try_uint() {
+			return self.data;
+		}
 };
 
 // namespace anserial
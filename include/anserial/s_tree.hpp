@@ -2,6 +2,7 @@
 
 #include <anserial/s_node.hpp>
 #include <anserial/deserializer.hpp>
+#include <anserial/symbol_table.hpp>
 
 namespace anserial {
 
@@ -22,15 +23,32 @@ class s_tree {
 		s_node *lookup(std::string& symbol);
 		s_node *lookup(uint32_t hash);
 
+		// names of every symbol in ::symtab, loaded on first use and
+		// again whenever ::symtab has grown
+		const symbol_table& symbols(void) {
+			sync_symbols();
+			return syms;
+		}
+
 		// update cached meta-objects, in case the deserializer
 		// parsed new entities
 		void refresh(void);
+
+		// stops the tree (and its deserializer) from changing any further.
+		// after this, every accessor on the tree and its nodes is read-only,
+		// so any number of threads can read concurrently without locks.
+		void freeze(void);
+		bool is_frozen(void) const { return frozen; }
 		void dump_nodes(void);
 		void dump_nodes(s_node *node, unsigned indent=0);
 
 	private:
+		// reloads the symbol table if ::symtab has grown since
+		void sync_symbols(void);
+
 		// TODO: should use a smart pointer here
 		deserializer *der = nullptr;
+		bool frozen = false;
 
 		struct {
 			// top-level node
@@ -42,6 +60,11 @@ class s_tree {
 			// main content
 			s_node *data;
 		} cached = {nullptr, nullptr, nullptr, nullptr};
+
+		symbol_table syms;
+		// ::symtab node and number of entries the table was loaded from
+		s_node *syms_node = nullptr;
+		size_t syms_entries = 0;
 };
 
 // namespace anserial
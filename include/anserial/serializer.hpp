@@ -4,6 +4,7 @@
 #include <map>
 #include <string>
 #include <list>
+#include <unordered_map>
 
 #include <anserial/s_node.hpp>
 
@@ -51,6 +52,17 @@ class serializer {
 		// last assigned entity ID
 		uint32_t ent_counter = 0;
 
+		// when set, subtrees written by add_entities() and add_string() are
+		// hashed once complete, and replaced by an ENT_TYPE_REF entity if an
+		// identical subtree was already written. those subtrees are assumed
+		// to be finished, so don't add more entities to them afterwards.
+		// the copy that was kept is shared by every reference to it, so a
+		// mutable_view writing into it later changes all of them at once.
+		bool dedup = false;
+
+		// byte order for output, set this before adding anything
+		ent_order order = ORDER_NETWORK;
+
 		// primitives for adding to the tree
 		uint32_t add_ent(uint32_t type, uint32_t parent, uint32_t data);
 		uint32_t add_container(uint32_t parent);
@@ -59,11 +71,17 @@ class serializer {
 		uint32_t add_integer(uint32_t parent, uint32_t data);
 		uint32_t add_string(uint32_t parent, const std::string& str);
 		uint32_t add_map(uint32_t parent);
+		// sets hold integers and symbols, nulls have no data
+		uint32_t add_set(uint32_t parent);
+		uint32_t add_null(uint32_t parent);
 
 		// convenience functions
 		uint32_t add_version(uint32_t parent);
 		uint32_t add_symtab(uint32_t parent);
 		uint32_t add_data(uint32_t parent);
+		// writes a seekable index of the top-level map and of ::data, see
+		// index.hpp. call this after add_symtab(), as the very last thing
+		uint32_t add_index(uint32_t parent);
 
 		// initializes an empty serializer to the default object layout,
 		// with a top-level map and ::-prefixed metadata.
@@ -74,11 +92,27 @@ class serializer {
 		// TODO: output callback function, so we can write data as it's being serialized
 		//       without buffering the full output
 		std::vector<uint32_t> serialize() { return output; };
+		// returns the output in the column-split block layout, see columnar.hpp
+		std::vector<uint32_t> serialize_columnar();
+		// returns the output as independently compressed blocks, see compress.hpp
+		std::vector<uint8_t> serialize_compressed();
 
 		uint32_t add_entities(uint32_t parent, ent_int);
 		uint32_t add_map_entry(uint32_t parent,
 		                       const std::string& symbol,
 		                       ent_int things);
+
+	private:
+		// checks the subtree from 'start' to the end of the output against
+		// earlier subtrees, returns the ID of whatever ends up in the output
+		uint32_t dedup_subtree(uint32_t start);
+		uint64_t subtree_hash(uint32_t start, uint32_t len);
+		bool same_subtree(uint32_t a, uint32_t b, uint32_t len);
+
+		// subtree hash -> top entity ID, along with the order things
+		// were added, so entries can be dropped if their subtree is undone
+		std::unordered_multimap<uint64_t, uint32_t> subtrees;
+		std::vector<std::pair<uint32_t, uint64_t>> subtree_log;
 };
 
 
@@ -0,0 +1,100 @@
+// hot path instrumentation
+//
+// counters are only updated when the library is built with ANSERIAL_STATS
+// defined, eg. `make STATS=1`. otherwise the macros below compile to
+// nothing, and get_stats() returns all zeros. the macros are only used in
+// the library's own .cpp files, inline code in headers calls
+// stat_add_out() instead, so code using the headers doesn't need to agree
+// with the library on ANSERIAL_STATS.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+namespace anserial {
+
+// snapshot of the counters
+struct stats {
+	// entities decoded by deserializers and written by serializers, by type
+	uint64_t entities_in[8];
+	uint64_t entities_out[8];
+
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+
+	// s_node objects, from any source
+	uint64_t nodes_allocated;
+	uint64_t nodes_freed;
+
+	// s_map::get() results
+	uint64_t map_hits;
+	uint64_t map_misses;
+
+	// entries written by serializer::add_symtab()
+	uint64_t symtab_entries;
+
+	// time spent in the main entry points, in nanoseconds
+	uint64_t add_ent_ns;
+	uint64_t deserialize_ns;
+	uint64_t parse_ns;
+};
+
+// true if the library was built with ANSERIAL_STATS
+bool stats_enabled(void);
+stats get_stats(void);
+void reset_stats(void);
+void dump_stats(FILE *fp);
+
+// counts entities of one type written by inline code, and their bytes
+void stat_add_out(uint32_t type, uint64_t entities);
+
+// live counters, use the macros below rather than these directly
+struct stat_counters {
+	std::atomic<uint64_t> entities_in[8];
+	std::atomic<uint64_t> entities_out[8];
+	std::atomic<uint64_t> bytes_in;
+	std::atomic<uint64_t> bytes_out;
+	std::atomic<uint64_t> nodes_allocated;
+	std::atomic<uint64_t> nodes_freed;
+	std::atomic<uint64_t> map_hits;
+	std::atomic<uint64_t> map_misses;
+	std::atomic<uint64_t> symtab_entries;
+	std::atomic<uint64_t> add_ent_ns;
+	std::atomic<uint64_t> deserialize_ns;
+	std::atomic<uint64_t> parse_ns;
+};
+
+extern stat_counters counters;
+
+// adds the time from construction to destruction to a counter
+class stat_timer {
+	public:
+		stat_timer(std::atomic<uint64_t>& ncounter)
+			: counter(ncounter), start(std::chrono::steady_clock::now()) {}
+
+		~stat_timer() {
+			auto end = std::chrono::steady_clock::now();
+			counter.fetch_add(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+				std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<uint64_t>& counter;
+		std::chrono::steady_clock::time_point start;
+};
+
+#if defined(ANSERIAL_STATS)
+#define ANSERIAL_STAT_ADD(field, n) \
+	(anserial::counters.field.fetch_add((n), std::memory_order_relaxed))
+#define ANSERIAL_STAT_TIMER(field) \
+	anserial::stat_timer anserial_timer_##field(anserial::counters.field)
+#else
+#define ANSERIAL_STAT_ADD(field, n) ((void)0)
+#define ANSERIAL_STAT_TIMER(field) ((void)0)
+#endif
+
+// namespace anserial
+}
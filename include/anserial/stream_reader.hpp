@@ -0,0 +1,89 @@
+#pragma once
+
+#include <anserial/deserializer.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace anserial {
+
+// reads serialized entities from a file descriptor or FILE* in large
+// blocks, handing out whole entities only. bytes of an entity split across
+// reads are carried over to the next block. with read-ahead, a thread
+// fills one buffer while the other is being decoded, so input from pipes
+// and sockets overlaps with decoding.
+class stream_reader {
+	public:
+		static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+		stream_reader(int fd, size_t block_size = DEFAULT_BLOCK_SIZE,
+		              bool read_ahead = true);
+		stream_reader(FILE *fp, size_t block_size = DEFAULT_BLOCK_SIZE,
+		              bool read_ahead = true);
+		// stops the read-ahead thread, interrupting a read that's waiting
+		// on a descriptor. a read from a FILE* can't be interrupted, so
+		// that's waited for. the input isn't closed.
+		~stream_reader();
+
+		stream_reader(const stream_reader&) = delete;
+		stream_reader& operator=(const stream_reader&) = delete;
+
+		// next run of whole entities, or nullptr at the end of input. the
+		// buffer stays valid until the next call. throws std::runtime_error
+		// on read errors.
+		uint32_t *next(size_t& entities);
+
+		// reads everything that's left into a deserializer, returns the
+		// number of entities read
+		size_t feed(deserializer& der);
+
+		// bytes read so far, and the bytes of an incomplete entity left
+		// at the end of input, which is nonzero for truncated input
+		size_t bytes_read(void) const { return total; }
+		size_t trailing_bytes(void) const { return done? ncarry : 0; }
+
+	private:
+		struct slot {
+			std::vector<uint32_t> buf;
+			size_t bytes = 0;
+			bool full = false;
+			bool eof = false;
+		};
+
+		void start(void);
+		void fill(slot& s);
+		void produce(void);
+		size_t read_some(uint8_t *buf, size_t len);
+
+		int fd = -1;
+		FILE *fp = nullptr;
+		size_t block_size;
+		bool read_ahead;
+
+		// partial entity left over from the last read
+		uint8_t carry[8];
+		size_t ncarry = 0;
+
+		slot slots[2];
+		unsigned current = 0;
+		bool holding = false;
+		bool done = false;
+		size_t total = 0;
+
+		std::thread reader;
+		std::mutex lock;
+		std::condition_variable cond;
+		std::exception_ptr error;
+		bool stopping = false;
+		// written to by the destructor, so the read-ahead thread can wait
+		// on it along with the input
+		int wake[2] = {-1, -1};
+};
+
+// namespace anserial
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <anserial/s_node.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace anserial {
+
+// symbol hash -> name lookups, loaded from a ::symtab in one pass. names are
+// kept back to back in one string pool, and found through an open addressed
+// table keyed by hash, so resolving a symbol is a multiply and (usually)
+// one probe, with no per-symbol allocations.
+//
+// since symbols are only 32 bit hashes, the loader also checks the table
+// itself: names that don't hash to their key, and keys that show up more
+// than once with different names, are reported rather than silently
+// picking one of them.
+class symbol_table {
+	public:
+		struct collision {
+			uint32_t hash;
+			// the name that was already there, and the one that replaced it
+			std::string first;
+			std::string second;
+		};
+
+		symbol_table() {}
+		// finds ::symtab in the top-level map of serialized entities,
+		// the byte order is detected from the buffer
+		symbol_table(const uint32_t *datas, size_t entities);
+		symbol_table(const uint32_t *datas, size_t entities, ent_order order);
+		// from an already deserialized ::symtab map
+		symbol_table(s_node *symtab);
+
+		void clear(void);
+		void load(const uint32_t *datas, size_t entities);
+		void load(const uint32_t *datas, size_t entities, ent_order order);
+		void load(s_node *symtab);
+		// adds one name, later names win over earlier ones like in s_map
+		void add(uint32_t hash, std::string_view name);
+
+		size_t size(void) const { return count; }
+
+		bool find(uint32_t hash, std::string_view& out) const {
+			const slot *s = probe(hash);
+			if (s) {
+				out = std::string_view(pool.data() + s->offset, s->length);
+			}
+			return s != nullptr;
+		}
+
+		bool contains(uint32_t hash) const { return probe(hash) != nullptr; }
+
+		// resolves a batch of hashes at once, faster than calling find()
+		// for each since the table lookups are overlapped. missing symbols
+		// give default constructed views, with a null data().
+		void resolve(const uint32_t *hashes, size_t n, std::string_view *out) const;
+
+		// resolves every symbol directly in a container, set or map (the
+		// keys, for maps), in the same order as entities() or keys().
+		// entities that aren't symbols are treated as missing.
+		void resolve(s_node *node, std::vector<std::string_view>& out) const;
+
+		const std::vector<collision>& collisions(void) const { return clashes; }
+		// keys whose name hashes to something else
+		const std::vector<uint32_t>& mismatches(void) const { return mismatched; }
+
+	private:
+		struct slot {
+			uint32_t hash;
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		static const uint32_t EMPTY = ~0u;
+
+		size_t index(uint32_t hash) const {
+			return (uint32_t)(hash * 2654435761u) >> shift;
+		}
+
+		const slot *probe(uint32_t hash) const {
+			if (slots.empty()) {
+				return nullptr;
+			}
+
+			size_t mask = slots.size() - 1;
+
+			for (size_t i = index(hash);; i = (i + 1) & mask) {
+				const slot& s = slots[i];
+
+				if (s.length == EMPTY) return nullptr;
+				if (s.hash == hash) return &s;
+			}
+		}
+
+		void grow(void);
+		// adds a name that's already at the end of the pool
+		void commit(uint32_t hash, uint32_t offset);
+
+		std::string pool;
+		std::vector<slot> slots;
+		unsigned shift = 32;
+		size_t count = 0;
+
+		std::vector<collision> clashes;
+		std::vector<uint32_t> mismatched;
+};
+
+// namespace anserial
+}
@@ -0,0 +1,50 @@
+// structural validation
+//
+// checks a buffer of entities in one pass before anything is built from
+// it, so untrusted input can be rejected up front instead of partway
+// through deserializing. a buffer that passes can be deserialized without
+// the deserializer throwing over its structure (limits aside):
+//
+// - every parent comes before its children, only the top entity is its own
+//   parent
+// - only containers, maps, sets and strings have children, and never
+//   through a reference
+// - string characters are integers, set members are integers or symbols
+// - map children alternate between symbol keys and values, and every key
+//   has a value
+// - references point back at an earlier entity that isn't a string
+//   character, and count as whatever they point to
+// - references come after everything under their target, so a target
+//   can't contain its own reference, directly or through other ones
+//
+// the parent and reference checks run over the raw words with SSE2 where
+// it's available, the rest only needs one byte of state per entity. when
+// there are references, one more pass finds where each subtree ends.
+#pragma once
+
+#include <anserial/base_ent.hpp>
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace anserial {
+
+struct validation {
+	static const uint32_t npos = ~0u;
+
+	// first entity that breaks a rule, and which rule. for map keys
+	// without a value, this is the map.
+	uint32_t entity = npos;
+	const char *error = nullptr;
+
+	bool ok(void) const { return error == nullptr; }
+	explicit operator bool(void) const { return ok(); }
+};
+
+// the byte order is detected from the buffer, see detect_order()
+validation validate(const uint32_t *datas, size_t entities);
+validation validate(const uint32_t *datas, size_t entities, ent_order order);
+validation validate(const std::vector<uint32_t>& datas);
+
+// namespace anserial
+}
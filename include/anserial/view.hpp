@@ -0,0 +1,309 @@
+// typed lazy views
+//
+// view<T> reads a struct described with ANSERIAL_BINDING (see binding.hpp)
+// straight from serialized entities, without decoding the whole thing:
+//
+//   anserial::view<result> v(buf, id);
+//   uint32_t x = v.get<&result::id>();
+//   auto samples = v.get<&result::samples>();   // list_view<uint32_t>
+//
+// the entity of each field is found once, when the view is made, and
+// fields are only decoded when they're accessed. nested structs give views
+// and vectors give list_views, which are just as lazy. elements of a
+// list_view are usually laid out the same way, so field positions found
+// for the first element are checked and reused for the others, rather
+// than searching each element's map again.
+#pragma once
+
+#include <anserial/binding.hpp>
+#include <array>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace anserial {
+
+template <typename T>
+class view;
+
+template <typename T>
+class list_view;
+
+namespace detail {
+
+template <typename T>
+using fields_type = std::decay_t<decltype(binding<T>::fields)>;
+
+template <typename T>
+constexpr size_t field_count(void) {
+	return std::tuple_size_v<fields_type<T>>;
+}
+
+template <typename A, typename B>
+constexpr bool same_member(A a, B b) {
+	if constexpr (std::is_same_v<A, B>) {
+		return a == b;
+	} else {
+		return false;
+	}
+}
+
+// view<T>::layout for bound types, nothing for anything else
+template <typename T, bool = is_bound<T>::value>
+struct view_layout {
+	struct type {};
+};
+
+template <typename T>
+struct view_layout<T, true> {
+	using type = std::array<uint32_t, field_count<T>()>;
+};
+
+// follows references to the entity they point at. references that don't
+// point back, or point into their own ancestors, give r.entities, which
+// reads as missing.
+static inline uint32_t resolve_ref(const raw_reader& r, uint32_t id) {
+	while (id < r.entities && r.type(id) == ENT_TYPE_REF) {
+		uint32_t target = r.data(id);
+
+		if (target >= id || r.is_ancestor(target, id)) {
+			return r.entities;
+		}
+
+		id = target;
+	}
+
+	return id;
+}
+
+// value of a field, either decoded or as another view
+template <typename M>
+auto view_value(const raw_reader& r, uint32_t id) {
+	id = (id < r.entities)? resolve_ref(r, id) : id;
+
+	if constexpr (is_bound<M>::value) {
+		return view<M>(r, id);
+
+	} else if constexpr (is_vector<M>::value) {
+		return list_view<typename M::value_type>(r, id);
+
+	} else if constexpr (std::is_same_v<M, std::string>) {
+		std::string ret;
+
+		if (id < r.entities && r.type(id) == ENT_TYPE_STRING) {
+			for (uint32_t j = id + 1; j < r.entities && r.parent(j) == id; j++) {
+				ret += r.data(j);
+			}
+		}
+
+		return ret;
+
+	} else {
+		static_assert(is_scalar_field<M>(), "type has no binding");
+
+		if (id < r.entities
+		    && (r.type(id) == ENT_TYPE_INTEGER || r.type(id) == ENT_TYPE_SYMBOL))
+		{
+			return (M)r.data(id);
+		}
+
+		return M{};
+	}
+}
+
+// namespace detail
+}
+
+template <typename T>
+class view {
+	public:
+		static const uint32_t npos = ~0u;
+		static constexpr size_t nfields = detail::field_count<T>();
+
+		// positions of each field relative to the top of the map
+		using layout = std::array<uint32_t, nfields>;
+
+		view() { ids.fill((uint32_t)npos); }
+
+		// the byte order is detected from the buffer
+		view(const uint32_t *datas, size_t entities, uint32_t id)
+			: view(detail::raw_reader{datas, entities, detect_order(datas, entities)}, id) {}
+
+		view(const std::vector<uint32_t>& datas, uint32_t id)
+			: view(datas.data(), datas.size() / 2, id) {}
+
+		// with a layout, the fields are first looked for at the
+		// same offsets, and only searched for if that fails
+		view(const detail::raw_reader& nr, uint32_t nid, const layout *hint = nullptr)
+			: r(nr), id(nid)
+		{
+			ids.fill((uint32_t)npos);
+
+			if (id >= r.entities || r.type(id) != ENT_TYPE_MAP) {
+				id = npos;
+				return;
+			}
+
+			if (!(hint && try_layout(*hint))) {
+				search();
+			}
+		}
+
+		// false if there's no map where the view was pointed
+		bool valid(void) const { return id != npos; }
+		uint32_t entity(void) const { return id; }
+
+		template <size_t I>
+		bool has(void) const { return ids[I] != npos; }
+
+		// field by index or by member pointer, fields missing from the
+		// input give default values (or invalid views)
+		template <size_t I>
+		auto at(void) const {
+			using M = typename std::tuple_element_t<I, detail::fields_type<T>>::member_type;
+			return detail::view_value<M>(r, ids[I]);
+		}
+
+		template <auto Member>
+		auto get(void) const {
+			constexpr size_t index = index_of<Member>();
+			static_assert(index < nfields, "member isn't part of the binding");
+			return at<index>();
+		}
+
+		// decodes everything, like anserial::decode()
+		bool materialize(T& out) const {
+			bool ok = valid();
+
+			if (ok) {
+				detail::decode_value(r, id, out, ok);
+			}
+
+			return ok;
+		}
+
+		layout offsets(void) const {
+			layout ret;
+
+			for (size_t i = 0; i < nfields; i++) {
+				ret[i] = (ids[i] != npos)? ids[i] - id : npos;
+			}
+
+			return ret;
+		}
+
+	private:
+		template <auto Member>
+		static constexpr size_t index_of(void) {
+			size_t ret = nfields, i = 0;
+
+			std::apply([&](const auto&... f) {
+				((ret = (ret == nfields && detail::same_member(f.member, Member))? i : ret, i++), ...);
+			}, binding<T>::fields);
+
+			return ret;
+		}
+
+		// checks that every field is where the layout says, by looking at
+		// the key entity right before it
+		bool try_layout(const layout& hint) {
+			size_t i = 0;
+			bool ok = true;
+
+			std::apply([&](const auto&... f) {
+				((ok = ok && check_field(hint[i], f.hash, ids[i]), i++), ...);
+			}, binding<T>::fields);
+
+			return ok;
+		}
+
+		bool check_field(uint32_t offset, uint32_t hash, uint32_t& out) const {
+			// fields missing from the first element are searched for
+			if (offset == npos || offset < 2 || id + offset >= r.entities) {
+				return false;
+			}
+
+			uint32_t value = id + offset;
+			uint32_t key = value - 1;
+
+			if (r.parent(value) != id || r.parent(key) != id
+			    || r.type(key) != ENT_TYPE_SYMBOL || r.data(key) != hash)
+			{
+				return false;
+			}
+
+			out = value;
+			return true;
+		}
+
+		void search(void) {
+			uint32_t j = id + 1;
+
+			while (j < r.entities && r.parent(j) == id) {
+				uint32_t hash = r.data(j);
+				j = r.skip(j);
+
+				if (j >= r.entities || r.parent(j) != id) {
+					break;
+				}
+
+				size_t i = 0;
+
+				// later entries win like they do in s_map
+				std::apply([&](const auto&... f) {
+					((ids[i] = (f.hash == hash)? j : ids[i], i++), ...);
+				}, binding<T>::fields);
+
+				j = r.skip(j);
+			}
+		}
+
+		detail::raw_reader r = {nullptr, 0, ORDER_NETWORK};
+		uint32_t id = npos;
+		std::array<uint32_t, nfields> ids;
+};
+
+template <typename T>
+class list_view {
+	public:
+		list_view() {}
+
+		list_view(const detail::raw_reader& nr, uint32_t id) : r(nr) {
+			if (id >= r.entities || r.type(id) != ENT_TYPE_CONTAINER) {
+				return;
+			}
+
+			for (uint32_t j = id + 1; j < r.entities && r.parent(j) == id; j = r.skip(j)) {
+				items.push_back(j);
+			}
+
+			if constexpr (is_bound<T>::value) {
+				if (!items.empty()) {
+					hint = view<T>(r, detail::resolve_ref(r, items[0])).offsets();
+				}
+			}
+		}
+
+		size_t size(void) const { return items.size(); }
+		bool empty(void) const { return items.empty(); }
+
+		// no bounds checking, same as std::vector
+		auto operator[](size_t i) const {
+			if constexpr (is_bound<T>::value) {
+				return view<T>(r, detail::resolve_ref(r, items[i]), &hint);
+			} else {
+				return detail::view_value<T>(r, items[i]);
+			}
+		}
+
+	private:
+		detail::raw_reader r = {nullptr, 0, ORDER_NETWORK};
+		std::vector<uint32_t> items;
+
+		// field offsets of the first element, for the others to try first
+		typename detail::view_layout<T>::type hint;
+};
+
+// namespace anserial
+}
@@ -1,91 +1,402 @@
 #include <anserial/anserial.hpp>
+#include <anserial/columnar.hpp>
+#include <anserial/compress.hpp>
+#include <anserial/index.hpp>
 #include <list>
 #include <vector>
 #include <map>
 #include <initializer_list>
 #include <stdint.h>
 #include <stdexcept>
+#include <typeinfo>
 #include <iostream>
 
-// for htonl/ntohl
-#include <arpa/inet.h>
-
 namespace anserial {
 
-serialized serialize_ent(const s_ent& ent) {
+serialized serialize_ent(const s_ent& ent, ent_order order) {
 	serialized ret;
 
-	ret.datas[0] = htonl((ent.d_type << 29) | ent.parent);
-	ret.datas[1] = htonl(ent.data);
+	ret.datas[0] = store_word((ent.d_type << 29) | ent.parent, order);
+	ret.datas[1] = store_word(ent.data, order);
 
 	return ret;
 }
 
-s_ent deserialize_ent(const serialized& ser) {
+s_ent deserialize_ent(const serialized& ser, ent_order order) {
 	s_ent ret;
 
-	ret.d_type = ntohl(ser.datas[0]) >> 29;
-	ret.parent = ntohl(ser.datas[0]) & ~(7 << 29);
-	ret.data   = ntohl(ser.datas[1]);
+	ret.d_type = load_word(ser.datas[0], order) >> 29;
+	ret.parent = load_word(ser.datas[0], order) & ~(7 << 29);
+	ret.data   = load_word(ser.datas[1], order);
 
 	return ret;
 }
 
-// TODO: move this somewhere better
-uint32_t hash_string(const std::string& str) {
-	unsigned hash = 19937;
+ent_order detect_order(const uint32_t *datas, size_t entities) {
+	// on big endian hosts both orders are the same anyway
+	if (entities > 0 && datas[1] != htonl(ORDER_MARK) && datas[1] == ORDER_MARK) {
+		// only count the mark where it could have been written, so an
+		// integer that happens to look like it isn't mistaken for one.
+		// the top entity is its own parent, so the rest of the tag is 0.
+		uint32_t tag = datas[0];
 
-	for (char c : str) {
-		hash = (hash << 7) + hash + c;
+		if ((tag & ~(7 << 29)) == 0 && carries_order_mark(tag >> 29)) {
+			return ORDER_NATIVE;
+		}
 	}
 
-	return hash;
+	return ORDER_NETWORK;
+}
+
+// TODO: move this somewhere better
+uint32_t hash_string(const std::string& str) {
+	return hash_symbol(str);
 }
 
 s_node *deserializer::deserialize() {
 	return (nodes.size() > 0)? nodes[0] : nullptr;
 }
 
-s_node *deserializer::deserialize(uint32_t *datas, size_t entities) {
-	for (unsigned i = 0; i < entities; i++) {
-		serialized buf;
-		buf.datas[0] = datas[2*i];
-		buf.datas[1] = datas[2*i + 1];
+s_node *deserializer::deserialize(const uint32_t *datas, size_t entities) {
+	ANSERIAL_STAT_TIMER(deserialize_ns);
+	ANSERIAL_STAT_ADD(bytes_in, 8*entities);
+
+	if (ent_counter == 0 && detect) {
+		order = detect_order(datas, entities);
+	}
+
+	if (order == ORDER_NATIVE) {
+		deserialize_range<ORDER_NATIVE>(datas, entities);
+	} else {
+		deserialize_range<ORDER_NETWORK>(datas, entities);
+	}
+
+	return deserialize();
+}
+
+template <ent_order O>
+void deserializer::deserialize_range(const uint32_t *datas, size_t entities) {
+	if (frozen && entities > 0) {
+		throw std::logic_error("deserializer::deserialize(): tree is frozen");
+	}
+
+	if (events && ev_types.size() != ent_counter) {
+		// events were switched on after entities were added, or an
+		// entity was rejected after its type was noted
+		sync_event_types();
+	}
+
+	for (size_t i = 0; i < entities; i++) {
+		// entities are read straight from the buffer, which costs nothing
+		// extra in native order since load_word() is a no-op there
+		uint32_t word = load_word(datas[2*i], O);
+
+		s_ent entity;
+		entity.d_type = word >> 29;
+		entity.parent = word & ~(7 << 29);
+		entity.data   = load_word(datas[2*i + 1], O);
+
+		ANSERIAL_STAT_ADD(entities_in[entity.d_type], 1);
+
+		// only the top entity can be its own parent
+		if ((ent_counter == 0)? entity.parent != 0 : entity.parent >= ent_counter) {
+			throw std::out_of_range("deserializer::deserialize(): parent ID is invalid");
+		}
+
+		if (limits.max_entities && ent_counter >= limits.max_entities) {
+			throw std::length_error("deserializer::deserialize(): entity limit exceeded");
+		}
+
+		// depths are kept even without a limit, so one can be set later on
+		uint32_t depth = (ent_counter == 0)? 0 : depths[entity.parent] + 1;
+
+		if (limits.max_depth && depth > limits.max_depth) {
+			throw std::length_error("deserializer::deserialize(): depth limit exceeded");
+		}
+
+		if (events) {
+			emit(entity);
+
+			if (!build_nodes) {
+				ent_counter++;
+				push_depth(depth);
+				continue;
+			}
+		}
+
+		size_t node_cap = nodes.capacity();
+		s_node *parent = (ent_counter == 0)? nullptr : nodes[entity.parent];
+
+		// characters are appended straight to their string, without
+		// materializing a node for each of them. the same goes for
+		// entities under anything that has no node, which can't be
+		// reached from the tree anyway.
+		if (ent_counter > 0
+		    && (!parent || (entity.d_type == ENT_TYPE_INTEGER
+		                    && typeid(*parent) == typeid(s_string))))
+		{
+			if (parent) {
+				std::string& str = static_cast<s_string*>(parent)->str;
+				size_t cap = str.capacity();
+
+				str += entity.data;
+				account(str.capacity() - cap);
+			}
+
+			ent_counter++;
+			nodes.push_back(nullptr);
+			account((nodes.capacity() - node_cap) * sizeof(s_node*));
+			push_depth(depth);
+			continue;
+		}
 
-		s_ent entity = deserialize_ent(buf);
 		s_node *temp;
+		size_t node_size;
 
 		switch (entity.d_type) {
-			case ENT_TYPE_CONTAINER: temp = new s_container; break;
-			case ENT_TYPE_MAP:       temp = new s_map; break;
-			case ENT_TYPE_STRING:    temp = new s_string; break;
-			case ENT_TYPE_SYMBOL:    temp = new s_symbol; break;
-			case ENT_TYPE_INTEGER:   temp = new s_uint; break;
+			case ENT_TYPE_CONTAINER: temp = new s_container; node_size = sizeof(s_container); break;
+			case ENT_TYPE_MAP:       temp = new s_map;       node_size = sizeof(s_map); break;
+			case ENT_TYPE_STRING:    temp = new s_string;    node_size = sizeof(s_string); break;
+			case ENT_TYPE_SYMBOL:    temp = new s_symbol;    node_size = sizeof(s_symbol); break;
+			case ENT_TYPE_INTEGER:   temp = new s_uint;      node_size = sizeof(s_uint); break;
+			case ENT_TYPE_SET:       temp = new s_set;       node_size = sizeof(s_set); break;
+			case ENT_TYPE_NULL:      temp = new s_null;      node_size = sizeof(s_null); break;
+
+			case ENT_TYPE_REF:
+				if (entity.data >= ent_counter || !nodes[entity.data]) {
+					throw std::out_of_range("deserializer::deserialize(): reference ID is invalid");
+				}
 
-			default: temp = new s_node; break;
-		}
+				temp = new s_ref(nodes[entity.data]);
+				node_size = sizeof(s_ref);
+				break;
 
-		if (entity.parent > ent_counter) {
-			throw std::out_of_range("deserializer::deserialize(): parent ID is invalid");
+			default: temp = new s_node; node_size = sizeof(s_node); break;
 		}
 
 		temp->self = entity;
 		temp->self.id = ent_counter++;
 
+		if (entity.d_type == ENT_TYPE_REF) {
+			s_node *target = static_cast<s_ref*>(temp)->target;
+			temp->self.d_type = target->self.d_type;
+			temp->self.data = target->self.data;
+		}
+
 		nodes.push_back(temp);
+		push_depth(depth);
+		parent = nodes[entity.parent];
+
+		// link node up to parent node, keeping track of how much the
+		// parent's vectors grew
+		size_t link_cap = parent->entities().capacity() + parent->keys().capacity();
+		size_t keys = parent->keys().size();
+
+		// sets also keep a hash set of their members
+		s_set *set = (typeid(*parent) == typeid(s_set))? static_cast<s_set*>(parent) : nullptr;
+		size_t members = set? set->members.size() : 0;
+		size_t buckets = set? set->members.bucket_count() : 0;
+
+		parent->link_ent(temp);
+
+		size_t grown = parent->entities().capacity() + parent->keys().capacity() - link_cap;
+		size_t map_nodes = parent->keys().size() - keys;
+
+		if (set) {
+			grown += set->members.bucket_count() - buckets;
+			map_nodes += set->members.size() - members;
+		}
 
-		// link node up to parent node
-		//nodes[temp->self.parent]->entities.push_back(temp);
-		nodes[temp->self.parent]->link_ent(temp);
+		account(node_size + ALLOC_OVERHEAD
+		        + (nodes.capacity() - node_cap + grown) * sizeof(s_node*)
+		        + map_nodes * MAP_NODE_SIZE);
 	}
+}
+
+void deserializer::emit(const s_ent& entity) {
+	uint32_t id = ent_counter;
+	uint8_t ptype = (id == 0)? (uint8_t)ENT_TYPE_NULL : ev_types[entity.parent] & 7;
+
+	if (entity.d_type == ENT_TYPE_REF && entity.data >= id) {
+		throw std::out_of_range("deserializer::deserialize(): reference ID is invalid");
+	}
+
+	size_t cap = ev_types.capacity();
+	ev_types.push_back(entity.d_type);
+	account(ev_types.capacity() - cap);
+
+	if (id > 0 && ptype == ENT_TYPE_STRING && entity.d_type == ENT_TYPE_INTEGER) {
+		if (pending.open && pending.id == entity.parent) {
+			pending.str += entity.data;
+		} else {
+			events->on_integer(entity.parent, id, entity.data);
+		}
 
-	return nodes[0];
+		return;
+	}
+
+	flush_string();
+
+	if (id > 0 && ptype == ENT_TYPE_MAP) {
+		uint8_t& flags = ev_types[entity.parent];
+		bool key = !(flags & 8);
+		flags ^= 8;
+
+		if (key) {
+			events->on_map_key(entity.parent, id, entity.data);
+			return;
+		}
+	}
+
+	switch (entity.d_type) {
+		case ENT_TYPE_CONTAINER: events->on_container(entity.parent, id); break;
+		case ENT_TYPE_MAP:       events->on_map(entity.parent, id); break;
+		case ENT_TYPE_SET:       events->on_set(entity.parent, id); break;
+		case ENT_TYPE_NULL:      events->on_null(entity.parent, id); break;
+		case ENT_TYPE_SYMBOL:    events->on_symbol(entity.parent, id, entity.data); break;
+		case ENT_TYPE_INTEGER:   events->on_integer(entity.parent, id, entity.data); break;
+
+		case ENT_TYPE_STRING:
+			pending.open = true;
+			pending.id = id;
+			pending.parent = entity.parent;
+			pending.str.clear();
+			break;
+
+		case ENT_TYPE_REF:
+			events->on_ref(entity.parent, id, entity.data);
+			break;
+	}
+}
+
+void deserializer::sync_event_types() {
+	if (!build_nodes) {
+		if (ev_types.size() < ent_counter) {
+			throw std::logic_error("deserializer::deserialize(): events set after "
+			                       "entities were added without nodes");
+		}
+
+		ev_types.resize(ent_counter);
+		return;
+	}
+
+	size_t cap = ev_types.capacity();
+	ev_types.resize(ent_counter);
+
+	for (uint32_t i = 0; i < ent_counter; i++) {
+		s_node *node = nodes[i];
+
+		if (!node) {
+			ev_types[i] = ENT_TYPE_INTEGER;
+		} else if (typeid(*node) == typeid(s_ref)) {
+			ev_types[i] = ENT_TYPE_REF;
+		} else {
+			ev_types[i] = node->self.d_type;
+
+			// maps waiting on a value
+			if (typeid(*node) == typeid(s_map) && static_cast<s_map*>(node)->have_sym) {
+				ev_types[i] |= 8;
+			}
+		}
+	}
+
+	account(ev_types.capacity() - cap);
+}
+
+void deserializer::flush_string() {
+	if (pending.open) {
+		pending.open = false;
+		events->on_string_complete(pending.parent, pending.id, pending.str);
+	}
+}
+
+void deserializer::finish() {
+	if (events) {
+		flush_string();
+	}
+}
+
+void deserializer::push_depth(uint32_t depth) {
+	size_t cap = depths.capacity();
+	depths.push_back(depth);
+	account((depths.capacity() - cap) * sizeof(uint32_t));
+}
+
+void deserializer::account(size_t bytes) {
+	bytes_allocated += bytes;
+	peak_bytes = (bytes_allocated > peak_bytes)? bytes_allocated : peak_bytes;
+
+	if (limits.max_bytes && bytes_allocated > limits.max_bytes) {
+		throw std::length_error("deserializer::deserialize(): memory limit exceeded");
+	}
+}
+
+// entities the limits still leave room for, counting the 8 bytes each
+// takes in a decompressed buffer against max_bytes
+size_t deserializer::entity_budget() const {
+	size_t ret = SIZE_MAX;
+
+	if (limits.max_entities) {
+		ret = (ent_counter < limits.max_entities)? limits.max_entities - ent_counter : 0;
+	}
+
+	if (limits.max_bytes) {
+		size_t room = (bytes_allocated < limits.max_bytes)? limits.max_bytes - bytes_allocated : 0;
+		ret = (room / 8 < ret)? room / 8 : ret;
+	}
+
+	return ret;
+}
+
+double deserializer::bytes_per_entity() const {
+	return ent_counter? (double)bytes_allocated / ent_counter : 0;
 }
 
 s_node *deserializer::deserialize(std::vector<uint32_t> datas) {
 	return deserialize(datas.data(), datas.size() / 2);
 }
 
+s_node *deserializer::deserialize_columnar(const uint32_t *blocks, size_t words) {
+	std::vector<uint32_t> buf;
+	size_t pos = 0;
+
+	while (pos < words) {
+		if (words - pos >= COLUMN_BLOCK_HEADER
+		    && ntohl(blocks[pos + 2]) != ent_counter)
+		{
+			throw std::out_of_range("deserializer::deserialize_columnar(): "
+			                        "block is out of order");
+		}
+
+		buf.clear();
+		pos += columnar_decode_block(blocks + pos, words - pos, buf);
+		// decoded blocks are always in network byte order
+		deserialize_range<ORDER_NETWORK>(buf.data(), buf.size() / 2);
+	}
+
+	return deserialize();
+}
+
+s_node *deserializer::deserialize_compressed(const uint8_t *buf, size_t len,
+                                             unsigned threads)
+{
+	// everything is decompressed into one buffer up front, so the limits
+	// are checked against the block headers before it's allocated
+	compressed_reader reader(buf, len, entity_budget());
+
+	if (reader.blocks().size() > 0
+	    && reader.blocks()[0].first_entity != ent_counter)
+	{
+		// block IDs always start at 0, so only allow compressed input
+		// for an empty deserializer
+		throw std::out_of_range("deserializer::deserialize_compressed(): "
+		                        "blocks don't start at the entity counter");
+	}
+
+	std::vector<uint32_t> datas = reader.decompress(threads);
+	return deserialize(datas.data(), datas.size() / 2);
+}
+
 ent_int::ent_int(uint32_t i) {
 	d_type = ENT_TYPE_INTEGER;
 	datas.i = i;
@@ -130,7 +441,7 @@ uint32_t serializer::add_entities(uint32_t parent, ent_int ent) {
 				for (auto& x : ent.datas.ents) {
 					add_entities(id, x);
 				}
-				return id;
+				return dedup_subtree(id);
 			}
 
 		case ENT_TYPE_SYMBOL:
@@ -147,6 +458,8 @@ uint32_t serializer::add_entities(uint32_t parent, ent_int ent) {
 }
 
 uint32_t serializer::add_ent(uint32_t type, uint32_t parent, uint32_t data) {
+	ANSERIAL_STAT_TIMER(add_ent_ns);
+
 	if (parent > ent_counter) {
 		throw std::out_of_range("serializer::add_ent(): parent ID is invalid");
 	}
@@ -159,13 +472,35 @@ uint32_t serializer::add_ent(uint32_t type, uint32_t parent, uint32_t data) {
 	ent.parent = parent;
 	ent.data   = data;
 
-	serialized buf = serialize_ent(ent);
+	// in native order, flag the stream by putting a byte order mark in the
+	// top-level entity, which has no meaningful data for these types
+	if (order == ORDER_NATIVE && ret == 0) {
+		if (!carries_order_mark(type)) {
+			throw std::invalid_argument("serializer::add_ent(): top entity "
+			                            "can't be marked as native order");
+		}
+
+		ent.data = ORDER_MARK;
+	}
+
+	serialized buf = serialize_ent(ent, order);
 	output.push_back(buf.datas[0]);
 	output.push_back(buf.datas[1]);
 
+	ANSERIAL_STAT_ADD(entities_out[type & 7], 1);
+	ANSERIAL_STAT_ADD(bytes_out, 8);
+
 	return ret;
 }
 
+std::vector<uint32_t> serializer::serialize_columnar() {
+	return columnar_encode(output.data(), output.size() / 2, order);
+}
+
+std::vector<uint8_t> serializer::serialize_compressed() {
+	return compress_entities(output);
+}
+
 uint32_t serializer::add_container(uint32_t parent) {
 	return add_ent(ENT_TYPE_CONTAINER, parent, 0);
 }
@@ -199,11 +534,102 @@ uint32_t serializer::add_string(uint32_t parent, const std::string& str) {
 		add_integer(str_id, c);
 	}
 
-	return ret;
+	return dedup_subtree(ret);
+}
+
+uint64_t serializer::subtree_hash(uint32_t start, uint32_t len) {
+	// FNV-1a over the subtree with parent IDs made relative to the top
+	// entity, and the top entity's parent left out, so identical subtrees
+	// hash the same wherever they are
+	uint64_t hash = 14695981039346656037ull;
+
+	for (uint32_t i = 0; i < len; i++) {
+		uint32_t word = load_word(output[2*(start + i)], order);
+		uint32_t parent = word & ~(7 << 29);
+		uint32_t rel = (i == 0)? (word & (7 << 29)) : ((word >> 29) << 29) | (parent - start);
+
+		hash = (hash ^ rel) * 1099511628211ull;
+		hash = (hash ^ output[2*(start + i) + 1]) * 1099511628211ull;
+	}
+
+	return (hash ^ len) * 1099511628211ull;
+}
+
+bool serializer::same_subtree(uint32_t a, uint32_t b, uint32_t len) {
+	for (uint32_t i = 0; i < len; i++) {
+		uint32_t wa = load_word(output[2*(a + i)], order);
+		uint32_t wb = load_word(output[2*(b + i)], order);
+
+		if ((wa >> 29) != (wb >> 29)
+		    || output[2*(a + i) + 1] != output[2*(b + i) + 1])
+		{
+			return false;
+		}
+
+		if (i > 0 && (wa & ~(7 << 29)) - a != (wb & ~(7 << 29)) - b) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint32_t serializer::dedup_subtree(uint32_t start) {
+	uint32_t len = ent_counter - start;
+
+	// single entities are never worth replacing with a reference
+	if (!dedup || len < 2) {
+		return start;
+	}
+
+	uint64_t hash = subtree_hash(start, len);
+	auto range = subtrees.equal_range(hash);
+
+	for (auto it = range.first; it != range.second; it++) {
+		uint32_t cand = it->second;
+
+		if (cand + len > start || !same_subtree(cand, start, len)) {
+			continue;
+		}
+
+		// undo the copy we just wrote, along with any subtrees
+		// recorded inside of it, and point at the original instead
+		uint32_t parent = load_word(output[2*start], order) & ~(7 << 29);
+
+		while (!subtree_log.empty() && subtree_log.back().first > start) {
+			auto sub = subtrees.equal_range(subtree_log.back().second);
+
+			for (auto k = sub.first; k != sub.second; k++) {
+				if (k->second == subtree_log.back().first) {
+					subtrees.erase(k);
+					break;
+				}
+			}
+
+			subtree_log.pop_back();
+		}
+
+		output.resize(2*start);
+		ent_counter = start;
+
+		return add_ent(ENT_TYPE_REF, parent, cand);
+	}
+
+	subtrees.emplace(hash, start);
+	subtree_log.push_back({start, hash});
+	return start;
 }
 
 uint32_t serializer::add_map(uint32_t parent) {
-	return add_ent(ENT_TYPE_MAP, parent, 0xcafebabe);
+	return add_ent(ENT_TYPE_MAP, parent, ORDER_MARK);
+}
+
+uint32_t serializer::add_set(uint32_t parent) {
+	return add_ent(ENT_TYPE_SET, parent, 0);
+}
+
+uint32_t serializer::add_null(uint32_t parent) {
+	return add_ent(ENT_TYPE_NULL, parent, 0);
 }
 
 uint32_t serializer::add_map_entry(uint32_t parent,
@@ -230,6 +656,7 @@ uint32_t serializer::add_symtab(uint32_t parent) {
 	// assumes the parent is a map itself
 	add_symbol(parent, "::symtab");
 	uint32_t cont = add_map(parent);
+	ANSERIAL_STAT_ADD(symtab_entries, symtab.size());
 
 	for (const auto& x : symtab) {
 		//uint32_t entry = add_container(cont);
@@ -240,6 +667,72 @@ uint32_t serializer::add_symtab(uint32_t parent) {
 	return cont;
 }
 
+uint32_t serializer::add_index(uint32_t parent) {
+	// assumes the parent is the top-level map, and that nothing gets
+	// added after this, since the trailer has to stay last
+	uint32_t n = ent_counter;
+	uint32_t data_id = ~0u;
+	uint32_t key = ~0u;
+
+	// which top-level value and which record each entity belongs to
+	std::vector<uint32_t> top_owner(n, ~0u);
+	std::vector<uint32_t> rec_owner(n, ~0u);
+	std::vector<uint32_t> ends(n, 0);
+
+	for (uint32_t i = parent + 1; i < n; i++) {
+		uint32_t p = load_word(output[2*i], order) & ~(7 << 29);
+
+		if (p == parent) {
+			// map children alternate between keys and values
+			if (key == ~0u) {
+				key = i;
+				continue;
+			}
+
+			if (load_word(output[2*key + 1], order) == hash_string("::data")) {
+				data_id = i;
+			}
+
+			top_owner[i] = i;
+			key = ~0u;
+
+		} else if (p > parent && p < i) {
+			top_owner[i] = top_owner[p];
+			rec_owner[i] = (p == data_id)? i : rec_owner[p];
+		}
+
+		if (top_owner[i] != ~0u) ends[top_owner[i]] = i + 1;
+		if (rec_owner[i] != ~0u) ends[rec_owner[i]] = i + 1;
+	}
+
+	add_symbol(parent, "::index");
+	uint32_t idx = add_container(parent);
+	uint32_t top = add_container(idx);
+
+	for (uint32_t i = parent + 1, k = ~0u; i < n; i++) {
+		if (top_owner[i] == i) {
+			add_integer(top, load_word(output[2*k + 1], order));
+			add_integer(top, i);
+			add_integer(top, ends[i]);
+
+		} else if ((load_word(output[2*i], order) & ~(7 << 29)) == parent) {
+			k = i;
+		}
+	}
+
+	uint32_t records = add_container(idx);
+
+	for (uint32_t i = parent + 1; i < n; i++) {
+		if (rec_owner[i] == i) {
+			add_integer(records, i);
+			add_integer(records, ends[i]);
+		}
+	}
+
+	add_integer(idx, INDEX_MAGIC);
+	return idx;
+}
+
 uint32_t serializer::default_layout() {
 	uint32_t top = add_map(0);
 	add_version(top);
@@ -248,6 +741,8 @@ uint32_t serializer::default_layout() {
 
 // TODO: might be a good idea to split this up into a few
 //       mutually-recursive functions
+// note that this only uses the try_*() accessors, so failed matches never
+// throw (and never insert missing symbols into maps)
 bool destructure(s_node *node, ent_int ent) {
 	if (ent.d_type == ENT_TYPE_NODE_PTR) {
 		if (ent.datas.nptr) {
@@ -270,9 +765,7 @@ bool destructure(s_node *node, ent_int ent) {
 		for (unsigned i = 0; i < ent.datas.ents.size(); i++, it++) {
 			// continue trying to match if we extend past the end of the container,
 			// so that ENT_TYPE_NODE_PTR types can match with null pointers.
-			s_node *next = (i < node->entities().size())? node->get(i) : nullptr;
-
-			if (!destructure(next, *it)) {
+			if (!destructure(node->try_get(i), *it)) {
 				return false;
 			}
 		}
@@ -287,13 +780,14 @@ bool destructure(s_node *node, ent_int ent) {
 
 		while (it != ent.datas.ents.end()) {
 			ent_int key = *it++;
-			ent_int pattern = *it++;
 
-			if (key.d_type != ENT_TYPE_SYMBOL) {
+			if (key.d_type != ENT_TYPE_SYMBOL || it == ent.datas.ents.end()) {
 				return false;
 			}
 
-			if (!destructure(node->get(key.datas.s_str), pattern)) {
+			ent_int pattern = *it++;
+
+			if (!destructure(node->try_get(key.datas.s_str), pattern)) {
 				return false;
 			}
 		}
@@ -304,13 +798,16 @@ bool destructure(s_node *node, ent_int ent) {
 	else if (node->self.d_type == ent.d_type) {
 		switch (ent.d_type) {
 			case ENT_TYPE_INTEGER:
-				return node->uint() == ent.datas.i;
+				return node->try_uint() == ent.datas.i;
 
 			case ENT_TYPE_SYMBOL:
-				return node->uint() == hash_string(ent.datas.s_str);
+				return node->try_uint() == hash_string(ent.datas.s_str);
 
 			case ENT_TYPE_STRING:
-				return node->string() == ent.datas.s_str;
+				{
+					std::string *str = node->try_string();
+					return str && *str == ent.datas.s_str;
+				}
 
 			default:
 				return false;
@@ -323,16 +820,26 @@ bool destructure(s_node *node, ent_int ent) {
 		// FIXME: type conversions result in wrong but consistent results...
 		// TODO:  find out why, add test case once test framework is up
 		//*ent.datas.uptr = *node;
-		*ent.datas.uptr = node->uint();
-		return true;
+		std::optional<uint32_t> value = node->try_uint();
+
+		if (value) {
+			*ent.datas.uptr = *value;
+		}
+
+		return value.has_value();
 	}
 
 	else if (node->self.d_type == ENT_TYPE_STRING
 	         && ent.d_type == ENT_TYPE_STRING_PTR)
 	{
 		//*ent.datas.sptr = (std::string)*node;
-		*ent.datas.sptr = node->string();
-		return true;
+		std::string *str = node->try_string();
+
+		if (str) {
+			*ent.datas.sptr = *str;
+		}
+
+		return str != nullptr;
 	}
 
 	return false;
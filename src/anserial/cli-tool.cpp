@@ -1,5 +1,6 @@
 #include <anserial/anserial.hpp>
 #include <anserial/parser.hpp>
+#include <string.h>
 
 using namespace anserial;
 
@@ -41,14 +42,25 @@ void gen_test_data(void) {
 void decode_dump(void) {
 	deserializer der;
 
-	uint32_t buf[1024];
-	size_t nred = 0;
+	stream_reader input(stdin);
+	input.feed(der);
 
-	while ((nred = fread(buf, 8, 512, stdin)) > 0) {
-		der.deserialize(buf, nred);
+	if (input.trailing_bytes()) {
+		fprintf(stderr, "; warning: input ends with %zu bytes of a partial entity\n",
+		        input.trailing_bytes());
 	}
 
 	s_tree foo(&der);
+
+	for (auto& c : foo.symbols().collisions()) {
+		fprintf(stderr, "; warning: symbol #x%x is both \"%s\" and \"%s\"\n",
+		        c.hash, c.first.c_str(), c.second.c_str());
+	}
+
+	for (uint32_t hash : foo.symbols().mismatches()) {
+		fprintf(stderr, "; warning: name of symbol #x%x doesn't match its hash\n", hash);
+	}
+
 	foo.dump_nodes();
 
 	/*
@@ -71,6 +83,9 @@ void decode_dump(void) {
 		printf("; parser version: %u.%u.%u\n", version.major, version.minor, version.patch);
 	}
 
+	printf("; memory: %zu bytes for %u entities (peak %zu), %.1f bytes/entity\n",
+	       der.bytes_allocated, der.ent_counter, der.peak_bytes, der.bytes_per_entity());
+
 	std::string blarg = "";
 
 	if (destructure(der.deserialize(), {"::symtab", {"::symtab", &blarg}})) {
@@ -93,16 +108,45 @@ void decode_dump(void) {
 	}
 }
 
+int validate_input(void) {
+	std::vector<uint32_t> buf;
+	stream_reader input(stdin);
+	size_t entities;
+
+	while (uint32_t *datas = input.next(entities)) {
+		buf.insert(buf.end(), datas, datas + 2*entities);
+	}
+
+	validation v = validate(buf);
+
+	if (input.trailing_bytes()) {
+		fprintf(stderr, "; warning: input ends with %zu bytes of a partial entity\n",
+		        input.trailing_bytes());
+	}
+
+	if (!v) {
+		printf("; invalid: entity %u (byte offset %zu): %s\n",
+		       v.entity, 8*(size_t)v.entity, v.error);
+		return 1;
+	}
+
+	printf("; valid: %zu entities\n", buf.size() / 2);
+	return 0;
+}
+
 void print_help(void) {
 	printf(
 		" -h : print this help and exit\n"
 		" -d : decode and dump serialized data from stdin\n"
 		" -e : serialize s-expressions from stdin\n"
 		" -t : generate some test data\n"
+		" -v : check serialized data from stdin without decoding it\n"
+		" -s : after any of the above, dump library statistics to stderr\n"
+		"      (needs a build with ANSERIAL_STATS, eg. `make STATS=1`)\n"
 	);
 }
 
-int main(int argc, char *argv[]) {
+int run(int argc, char *argv[]) {
 	if (argc > 1) {
 		switch (argv[1][1]) {
 			case 'h':
@@ -121,6 +165,11 @@ int main(int argc, char *argv[]) {
 			case 't':
 				gen_test_data();
 				return 0;
+			case 'v':
+				return validate_input();
+			case 's':
+				dump_stats(stderr);
+				return 0;
 			default:
 				puts("invalid option!");
 				print_help();
@@ -133,3 +182,15 @@ int main(int argc, char *argv[]) {
 
 	return 0;
 }
+
+int main(int argc, char *argv[]) {
+	int ret = run(argc, argv);
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0) {
+			dump_stats(stderr);
+		}
+	}
+
+	return ret;
+}
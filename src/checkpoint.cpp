@@ -0,0 +1,243 @@
+#include <anserial/deserializer.hpp>
+#include <anserial/compress.hpp>
+#include <stdexcept>
+#include <typeinfo>
+#include <string.h>
+
+#include <arpa/inet.h>
+
+namespace anserial {
+
+// magic, entity count, input offset (2 words), byte order, flags, then the
+// pending string for events: open flag, ID, parent, length, characters
+static const size_t CHECKPOINT_HEADER = 10*4;
+
+// set when the nodes were saved, rather than just the event state
+static const uint32_t CHECKPOINT_NODES = 1;
+
+static void put_word(std::vector<uint8_t>& buf, uint32_t word) {
+	word = htonl(word);
+	buf.insert(buf.end(), (uint8_t*)&word, (uint8_t*)&word + 4);
+}
+
+static uint32_t get_word(const uint8_t *buf) {
+	uint32_t word;
+	memcpy(&word, buf, 4);
+	return ntohl(word);
+}
+
+// entities equivalent to what was decoded, rebuilt from the nodes. string
+// characters don't have nodes, so they're handed back out to strings with
+// characters left over, the most recent string first, which gives the
+// original stream for anything the serializer wrote. other entities without
+// nodes (under characters) are put under the previous one, so they stay
+// unreachable.
+static std::vector<uint32_t> rebuild_entities(const std::vector<s_node*>& nodes,
+                                              uint32_t entities)
+{
+	std::vector<uint32_t> ret(2*entities);
+	// strings still owed characters, and how many they've been given
+	std::vector<std::pair<s_string*, size_t>> strings;
+	uint32_t nodeless = ~0u;
+
+	for (uint32_t i = 0; i < entities; i++) {
+		s_node *node = nodes[i];
+		uint32_t tag, data;
+
+		if (!node) {
+			while (!strings.empty() && strings.back().second == strings.back().first->str.size()) {
+				strings.pop_back();
+			}
+
+			if (!strings.empty()) {
+				auto& s = strings.back();
+				tag = (ENT_TYPE_INTEGER << 29) | s.first->self.id;
+				data = (uint8_t)s.first->str[s.second++];
+
+			} else if (nodeless != ~0u) {
+				tag = (ENT_TYPE_INTEGER << 29) | nodeless;
+				data = 0;
+
+			} else {
+				throw std::logic_error("deserializer::checkpoint(): entity without a node or parent");
+			}
+
+			nodeless = i;
+
+		} else if (typeid(*node) == typeid(s_ref)) {
+			// references take on the type and data of their target
+			tag = (ENT_TYPE_REF << 29) | node->self.parent;
+			data = static_cast<s_ref*>(node)->target->self.id;
+
+			// a reference to an integer under a string adds a character
+			// to it too
+			s_node *parent = nodes[node->self.parent];
+
+			for (auto it = strings.rbegin(); it != strings.rend(); it++) {
+				if (it->first == parent && node->self.d_type == ENT_TYPE_INTEGER) {
+					it->second++;
+					break;
+				}
+			}
+
+		} else {
+			tag = (node->self.d_type << 29) | node->self.parent;
+			data = node->self.data;
+
+			if (typeid(*node) == typeid(s_string)) {
+				strings.push_back({static_cast<s_string*>(node), 0});
+			}
+		}
+
+		ret[2*i] = htonl(tag);
+		ret[2*i + 1] = htonl(data);
+	}
+
+	return ret;
+}
+
+// without nodes, each entity's event type and depth are saved instead,
+// as pairs of words so they compress like entities do
+static std::vector<uint32_t> event_state(const std::vector<uint8_t>& types,
+                                         const std::vector<uint32_t>& depths,
+                                         uint32_t entities)
+{
+	std::vector<uint32_t> ret(2*entities);
+
+	for (uint32_t i = 0; i < entities; i++) {
+		ret[2*i] = htonl(types[i]);
+		ret[2*i + 1] = htonl(depths[i]);
+	}
+
+	return ret;
+}
+
+std::vector<uint8_t> deserializer::checkpoint(uint64_t input_offset) const {
+	bool have_nodes = !(events && !build_nodes);
+
+	std::vector<uint8_t> ret;
+	put_word(ret, CHECKPOINT_MAGIC);
+	put_word(ret, ent_counter);
+	put_word(ret, input_offset >> 32);
+	put_word(ret, input_offset);
+	put_word(ret, order);
+	put_word(ret, have_nodes? CHECKPOINT_NODES : 0);
+
+	put_word(ret, pending.open);
+	put_word(ret, pending.open? pending.id : 0);
+	put_word(ret, pending.open? pending.parent : 0);
+	put_word(ret, pending.open? pending.str.size() : 0);
+
+	if (pending.open) {
+		ret.insert(ret.end(), pending.str.begin(), pending.str.end());
+		ret.resize((ret.size() + 3) & ~(size_t)3);
+	}
+
+	std::vector<uint32_t> ents = have_nodes
+		? rebuild_entities(nodes, ent_counter)
+		: event_state(ev_types, depths, ent_counter);
+
+	std::vector<uint8_t> blocks = compress_entities(ents);
+	ret.insert(ret.end(), blocks.begin(), blocks.end());
+
+	return ret;
+}
+
+uint64_t deserializer::restore(const uint8_t *buf, size_t len, unsigned threads) {
+	if (ent_counter > 0) {
+		throw std::logic_error("deserializer::restore(): deserializer isn't empty");
+	}
+
+	if (len < CHECKPOINT_HEADER || get_word(buf) != CHECKPOINT_MAGIC) {
+		throw std::invalid_argument("deserializer::restore(): not a checkpoint");
+	}
+
+	uint32_t entities = get_word(buf + 4);
+	uint64_t offset = ((uint64_t)get_word(buf + 8) << 32) | get_word(buf + 12);
+	uint32_t saved_order = get_word(buf + 16);
+	bool have_nodes = get_word(buf + 20) & CHECKPOINT_NODES;
+	bool open = get_word(buf + 24);
+	uint32_t str_len = get_word(buf + 36);
+	size_t pos = CHECKPOINT_HEADER + ((str_len + 3) & ~(size_t)3);
+
+	if (saved_order > ORDER_NATIVE || str_len > len || pos > len) {
+		throw std::invalid_argument("deserializer::restore(): checkpoint header is corrupt");
+	}
+
+	if (have_nodes != !(events && !build_nodes)) {
+		throw std::logic_error(have_nodes
+			? "deserializer::restore(): checkpoint has nodes, but none are being built"
+			: "deserializer::restore(): checkpoint has no nodes, only events can be restored");
+	}
+
+	if (have_nodes) {
+		// rebuilt entities are always in network order, and the restored
+		// entities aren't news to whoever is listening for events
+		deserializer_events *saved_events = events;
+		bool saved_detect = detect;
+		events = nullptr;
+		detect = false;
+		order = ORDER_NETWORK;
+
+		try {
+			deserialize_compressed(buf + pos, len - pos, threads);
+		} catch (...) {
+			events = saved_events;
+			detect = saved_detect;
+			throw;
+		}
+
+		events = saved_events;
+		detect = saved_detect;
+
+		if (ent_counter != entities) {
+			throw std::invalid_argument("deserializer::restore(): checkpoint is truncated");
+		}
+
+		if (events) {
+			sync_event_types();
+		}
+
+	} else {
+		compressed_reader reader(buf + pos, len - pos, entity_budget());
+
+		if (reader.entities() != entities) {
+			throw std::invalid_argument("deserializer::restore(): checkpoint is truncated");
+		}
+
+		std::vector<uint32_t> state = reader.decompress(threads);
+		ev_types.resize(entities);
+		depths.resize(entities);
+
+		for (uint32_t i = 0; i < entities; i++) {
+			uint32_t type = ntohl(state[2*i]);
+
+			// only maps have anything past the type
+			if (type >= 16 || (type > 7 && (type & 7) != ENT_TYPE_MAP)) {
+				ev_types.clear();
+				depths.clear();
+				throw std::invalid_argument("deserializer::restore(): checkpoint is corrupt");
+			}
+
+			ev_types[i] = type;
+			depths[i] = ntohl(state[2*i + 1]);
+		}
+
+		ent_counter = entities;
+		account(ev_types.capacity() + depths.capacity() * sizeof(uint32_t));
+	}
+
+	order = (ent_order)saved_order;
+	pending.open = open;
+
+	if (open) {
+		pending.id = get_word(buf + 28);
+		pending.parent = get_word(buf + 32);
+		pending.str.assign((const char*)buf + CHECKPOINT_HEADER, str_len);
+	}
+
+	return offset;
+}
+
+// namespace anserial
+}
@@ -0,0 +1,140 @@
+#include <anserial/columnar.hpp>
+#include <stdexcept>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace anserial {
+
+std::vector<uint32_t> columnar_encode(const uint32_t *datas, size_t entities,
+                                      ent_order order)
+{
+	std::vector<uint32_t> ret;
+	size_t blocks = (entities + COLUMN_BLOCK_ENTITIES - 1) / COLUMN_BLOCK_ENTITIES;
+
+	ret.reserve(blocks*(COLUMN_BLOCK_HEADER + COLUMN_BLOCK_ENTITIES/4)
+	            + 2*entities);
+
+	for (size_t start = 0; start < entities; start += COLUMN_BLOCK_ENTITIES) {
+		size_t n = entities - start;
+		n = (n > COLUMN_BLOCK_ENTITIES)? COLUMN_BLOCK_ENTITIES : n;
+
+		ret.push_back(htonl(COLUMN_BLOCK_MAGIC));
+		ret.push_back(htonl(n));
+		ret.push_back(htonl(start));
+
+		size_t type_words = (n + 3) / 4;
+		size_t types = ret.size();
+		size_t deltas = types + type_words;
+		size_t dataw = deltas + n;
+		ret.resize(dataw + n);
+
+		uint8_t *type_bytes = (uint8_t*)(ret.data() + types);
+		memset(type_bytes, 0, 4*type_words);
+
+		for (size_t i = 0; i < n; i++) {
+			uint32_t id = start + i;
+			uint32_t word = load_word(datas[2*id], order);
+			uint32_t parent = word & ~(7 << 29);
+
+			type_bytes[i] = word >> 29;
+			ret[deltas + i] = htonl(id - parent);
+			ret[dataw + i] = htonl(load_word(datas[2*id + 1], order));
+		}
+	}
+
+	return ret;
+}
+
+std::vector<uint32_t> columnar_encode(const std::vector<uint32_t>& datas,
+                                      ent_order order)
+{
+	return columnar_encode(datas.data(), datas.size() / 2, order);
+}
+
+#if defined(__SSE2__)
+// byte swap for each 32-bit lane, SSE2 has no byte shuffle so this is
+// done with word swaps and shifts
+static inline __m128i bswap_epi32(__m128i x) {
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+#endif
+
+size_t columnar_decode_block(const uint32_t *block, size_t words,
+                             std::vector<uint32_t>& out)
+{
+	if (words < COLUMN_BLOCK_HEADER || ntohl(block[0]) != COLUMN_BLOCK_MAGIC) {
+		throw std::invalid_argument("columnar_decode_block(): invalid block header");
+	}
+
+	uint32_t n = ntohl(block[1]);
+	uint32_t start = ntohl(block[2]);
+	size_t type_words = (n + 3) / 4;
+	size_t total = COLUMN_BLOCK_HEADER + type_words + 2*n;
+
+	if (n > COLUMN_BLOCK_ENTITIES || total > words) {
+		throw std::invalid_argument("columnar_decode_block(): truncated block");
+	}
+
+	const uint8_t  *types  = (const uint8_t*)(block + COLUMN_BLOCK_HEADER);
+	const uint32_t *deltas = block + COLUMN_BLOCK_HEADER + type_words;
+	const uint32_t *datas  = deltas + n;
+
+	size_t base = out.size();
+	out.resize(base + 2*n);
+	uint32_t *dest = out.data() + base;
+	uint32_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+
+	for (; i + 4 <= n; i += 4) {
+		uint32_t tword;
+		memcpy(&tword, types + i, 4);
+
+		__m128i t = _mm_cvtsi32_si128(tword);
+		t = _mm_unpacklo_epi8(t, zero);
+		t = _mm_unpacklo_epi16(t, zero);
+		t = _mm_slli_epi32(t, 29);
+
+		__m128i ids = _mm_add_epi32(_mm_set1_epi32(start + i), lanes);
+		__m128i d = bswap_epi32(_mm_loadu_si128((const __m128i*)(deltas + i)));
+		__m128i head = bswap_epi32(_mm_or_si128(t, _mm_sub_epi32(ids, d)));
+		__m128i data = _mm_loadu_si128((const __m128i*)(datas + i));
+
+		_mm_storeu_si128((__m128i*)(dest + 2*i),     _mm_unpacklo_epi32(head, data));
+		_mm_storeu_si128((__m128i*)(dest + 2*i + 4), _mm_unpackhi_epi32(head, data));
+	}
+#endif
+
+	for (; i < n; i++) {
+		uint32_t parent = (start + i) - ntohl(deltas[i]);
+		dest[2*i]     = htonl(((uint32_t)types[i] << 29) | parent);
+		dest[2*i + 1] = datas[i];
+	}
+
+	return total;
+}
+
+std::vector<uint32_t> columnar_decode(const uint32_t *blocks, size_t words) {
+	std::vector<uint32_t> ret;
+	size_t pos = 0;
+
+	while (pos < words) {
+		pos += columnar_decode_block(blocks + pos, words - pos, ret);
+	}
+
+	return ret;
+}
+
+bool is_columnar(const uint32_t *datas, size_t words) {
+	return words >= COLUMN_BLOCK_HEADER && ntohl(datas[0]) == COLUMN_BLOCK_MAGIC;
+}
+
+// namespace anserial
+}
@@ -0,0 +1,288 @@
+#include <anserial/compact_tree.hpp>
+#include <stdexcept>
+#include <stdio.h>
+
+namespace anserial {
+
+compact_tree::compact_tree(const uint32_t *datas, size_t entities) {
+	build(datas, entities, detect_order(datas, entities));
+}
+
+compact_tree::compact_tree(const uint32_t *datas, size_t entities, ent_order order) {
+	build(datas, entities, order);
+}
+
+compact_tree::compact_tree(const std::vector<uint32_t>& datas)
+	: compact_tree(datas.data(), datas.size() / 2) {}
+
+// whether a child of this type is kept under a parent of type 'ptype',
+// anything else can't be reached from an s_node tree either
+static inline bool keeps_child(uint32_t ptype, uint32_t type) {
+	switch (ptype) {
+		case ENT_TYPE_CONTAINER:
+		case ENT_TYPE_MAP:
+		case ENT_TYPE_SET:
+			return true;
+
+		case ENT_TYPE_STRING:
+			return type == ENT_TYPE_INTEGER;
+
+		default:
+			return false;
+	}
+}
+
+void compact_tree::build(const uint32_t *datas, size_t entities, ent_order order) {
+	nodes.resize(entities);
+
+	// first pass, decode entities and count children, using 'count'
+	for (size_t i = 0; i < entities; i++) {
+		uint32_t tag = load_word(datas[2*i], order);
+		uint32_t data = load_word(datas[2*i + 1], order);
+		compact_node& n = nodes[i];
+
+		n = {tag, data, 0, 0};
+
+		// only the top-level entity can be its own parent
+		if ((i == 0)? n.parent() != 0 : n.parent() >= i) {
+			throw std::out_of_range("compact_tree: parent ID is invalid");
+		}
+
+		if (n.type() == ENT_TYPE_REF && data >= i) {
+			throw std::out_of_range("compact_tree: reference ID is invalid");
+		}
+
+		// the top-level entity is its own parent, don't link it to itself
+		if (i > 0 && keeps_child(nodes[n.parent()].type(), n.type())) {
+			nodes[n.parent()].count++;
+		}
+	}
+
+	// assign ranges in the child index and the string pool
+	size_t child_total = 0, pool_total = 0;
+
+	for (compact_node& n : nodes) {
+		if (n.type() == ENT_TYPE_STRING) {
+			n.first = pool_total;
+			pool_total += n.count;
+
+		} else {
+			n.first = child_total;
+			child_total += n.count;
+		}
+
+		n.count = 0;
+	}
+
+	children.resize(child_total);
+	pool.resize(pool_total);
+
+	// second pass, fill in the ranges
+	for (size_t i = 1; i < entities; i++) {
+		compact_node& p = nodes[nodes[i].parent()];
+
+		if (!keeps_child(p.type(), nodes[i].type())) {
+			continue;
+		}
+
+		if (p.type() == ENT_TYPE_STRING) {
+			pool[p.first + p.count++] = nodes[i].data;
+		} else {
+			children[p.first + p.count++] = i;
+		}
+	}
+
+	// references share their target's ranges, so there's nothing to copy.
+	// targets always come first, so chains of references resolve in order.
+	for (size_t i = 0; i < entities; i++) {
+		compact_node& n = nodes[i];
+
+		if (n.type() == ENT_TYPE_REF) {
+			const compact_node& t = nodes[n.data];
+			n = {(t.tag & (7 << 29)) | n.parent(), t.data, t.first, t.count};
+		}
+	}
+
+	if (!nodes.empty() && nodes[0].type() == ENT_TYPE_MAP) {
+		cached.symtab  = get_hash(0, hash_string("::symtab"));
+		cached.version = get_hash(0, hash_string("::version"));
+		cached.data    = get_hash(0, hash_string("::data"));
+	}
+
+	for (uint32_t i = 0; i < count(cached.symtab); i++) {
+		uint32_t value = get(cached.symtab, i);
+
+		if (type(value) == ENT_TYPE_STRING) {
+			syms.add(nodes[key(cached.symtab, i)].data, string(value));
+		}
+	}
+}
+
+uint32_t compact_tree::count(uint32_t id) const {
+	switch (type(id)) {
+		case ENT_TYPE_MAP:
+			return nodes[id].count / 2;
+
+		case ENT_TYPE_CONTAINER:
+		case ENT_TYPE_SET:
+		case ENT_TYPE_STRING:
+			return nodes[id].count;
+
+		default:
+			return 0;
+	}
+}
+
+uint32_t compact_tree::get(uint32_t id, uint32_t index) const {
+	switch (type(id)) {
+		case ENT_TYPE_CONTAINER:
+		case ENT_TYPE_SET:
+			return (index < nodes[id].count)? children[nodes[id].first + index] : npos;
+
+		case ENT_TYPE_MAP:
+			return (index < nodes[id].count / 2)?
+				children[nodes[id].first + 2*index + 1] : npos;
+
+		default:
+			return npos;
+	}
+}
+
+uint32_t compact_tree::key(uint32_t id, uint32_t index) const {
+	if (type(id) != ENT_TYPE_MAP || 2*index >= nodes[id].count) {
+		return npos;
+	}
+
+	return children[nodes[id].first + 2*index];
+}
+
+uint32_t compact_tree::get(uint32_t id, const std::string& symbol) const {
+	return get_hash(id, hash_string(symbol));
+}
+
+uint32_t compact_tree::get_hash(uint32_t id, uint32_t hash) const {
+	if (type(id) != ENT_TYPE_MAP) {
+		return npos;
+	}
+
+	const compact_node& n = nodes[id];
+
+	// search backwards, so later entries win like they do in s_map
+	for (uint32_t k = n.count / 2; k > 0; k--) {
+		if (nodes[children[n.first + 2*(k - 1)]].data == hash) {
+			return children[n.first + 2*(k - 1) + 1];
+		}
+	}
+
+	return npos;
+}
+
+bool compact_tree::uint(uint32_t id, uint32_t& out) const {
+	switch (type(id)) {
+		case ENT_TYPE_INTEGER:
+		case ENT_TYPE_SYMBOL:
+			out = nodes[id].data;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+std::string_view compact_tree::string(uint32_t id) const {
+	if (type(id) != ENT_TYPE_STRING) {
+		return std::string_view();
+	}
+
+	return std::string_view(pool.data() + nodes[id].first, nodes[id].count);
+}
+
+uint32_t compact_tree::data(void) const {
+	return (cached.data != npos)? cached.data : top();
+}
+
+uint32_t compact_tree::lookup(uint32_t hash) const {
+	return get_hash(cached.symtab, hash);
+}
+
+void compact_tree::dump_nodes(void) const {
+	dump_nodes(top(), 0);
+}
+
+// same output as s_tree::dump_nodes()
+void compact_tree::dump_nodes(uint32_t id, unsigned indent) const {
+	if (id >= nodes.size()) {
+		printf("#<nullptr>");
+		return;
+	}
+
+	const compact_node& n = nodes[id];
+	printf("%*s", 4*indent, " ");
+
+	switch (n.type()) {
+		case ENT_TYPE_CONTAINER:
+			printf("(");
+			for (uint32_t i = 0; i < n.count; i++) {
+				putchar('\n');
+				dump_nodes(children[n.first + i], indent + 1);
+			}
+			putchar(')');
+			break;
+
+		case ENT_TYPE_MAP:
+			printf("(map");
+			for (uint32_t i = 0; i < (n.count + 1) / 2; i++) {
+				putchar('\n');
+
+				uint32_t k = key(id, i);
+				dump_nodes(k, indent + 1);
+				dump_nodes(get_hash(id, nodes[k].data), indent + 1);
+			}
+			putchar(')');
+			break;
+
+		case ENT_TYPE_SET:
+			printf("(set");
+			for (uint32_t i = 0; i < n.count; i++) {
+				putchar('\n');
+				dump_nodes(children[n.first + i], indent + 1);
+			}
+			putchar(')');
+			break;
+
+		case ENT_TYPE_NULL:
+			printf("#<null>");
+			break;
+
+		case ENT_TYPE_STRING:
+			{
+				std::string_view str = string(id);
+				printf("\"%.*s\"", (int)str.size(), str.data());
+			}
+			break;
+
+		case ENT_TYPE_SYMBOL:
+			{
+				std::string_view str;
+
+				if (syms.find(n.data, str)) {
+					printf("%.*s ", (int)str.size(), str.data());
+
+				} else {
+					printf("#<symbol:#x%x>", n.data);
+				}
+			}
+			break;
+
+		case ENT_TYPE_INTEGER:
+			printf("%u", n.data);
+			break;
+	}
+
+	if (indent == 0) {
+		putchar('\n');
+	}
+}
+
+// namespace anserial
+}
@@ -0,0 +1,381 @@
+#include <anserial/compress.hpp>
+#include <stdexcept>
+#include <exception>
+#include <thread>
+#include <string.h>
+
+// for htonl/ntohl
+#include <arpa/inet.h>
+
+namespace anserial {
+
+// LZ sequences are encoded as:
+//
+//   token:      high nibble is the literal length, low nibble is the
+//               match length - LZ_MIN_MATCH, 15 means more length bytes follow
+//   literals
+//   offset:     2 bytes little endian, omitted for the last sequence
+//   more match length bytes
+//
+// runs of repeated entities show up as matches with small offsets, so
+// there's no need for a separate RLE pass.
+static const size_t LZ_MIN_MATCH = 4;
+static const unsigned LZ_HASH_BITS = 14;
+static const size_t LZ_MAX_OFFSET = 0xffff;
+// most bytes a byte of input can decompress to, from match length bytes
+static const size_t LZ_MAX_RATIO = 255;
+
+static inline uint32_t read32(const uint8_t *p) {
+	uint32_t ret;
+	memcpy(&ret, p, 4);
+	return ret;
+}
+
+static inline uint32_t lz_hash(uint32_t x) {
+	return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static void put_length(std::vector<uint8_t>& out, size_t len) {
+	while (len >= 255) {
+		out.push_back(255);
+		len -= 255;
+	}
+
+	out.push_back(len);
+}
+
+static void put_sequence(std::vector<uint8_t>& out,
+                         const uint8_t *lits, size_t nlits,
+                         size_t offset, size_t match)
+{
+	size_t mlen = match? match - LZ_MIN_MATCH : 0;
+	uint8_t token = ((nlits < 15)? nlits : 15) << 4;
+	token |= (mlen < 15)? mlen : 15;
+
+	out.push_back(token);
+
+	if (nlits >= 15) {
+		put_length(out, nlits - 15);
+	}
+
+	out.insert(out.end(), lits, lits + nlits);
+
+	if (match) {
+		out.push_back(offset & 0xff);
+		out.push_back(offset >> 8);
+
+		if (mlen >= 15) {
+			put_length(out, mlen - 15);
+		}
+	}
+}
+
+void lz_compress(const uint8_t *in, size_t len, std::vector<uint8_t>& out) {
+	std::vector<uint32_t> table(1 << LZ_HASH_BITS, 0);
+	size_t anchor = 0;
+	size_t i = 0;
+
+	while (i + LZ_MIN_MATCH <= len) {
+		uint32_t cur = read32(in + i);
+		uint32_t h = lz_hash(cur);
+		// positions are stored + 1 so 0 can mean "empty"
+		size_t cand = table[h];
+		table[h] = i + 1;
+
+		if (cand == 0 || i - (cand - 1) > LZ_MAX_OFFSET
+		    || read32(in + cand - 1) != cur)
+		{
+			i++;
+			continue;
+		}
+
+		cand--;
+		size_t match = LZ_MIN_MATCH;
+		while (i + match < len && in[cand + match] == in[i + match]) {
+			match++;
+		}
+
+		put_sequence(out, in + anchor, i - anchor, i - cand, match);
+		i += match;
+		anchor = i;
+	}
+
+	// trailing literals, always emitted so the decoder knows where to stop
+	put_sequence(out, in + anchor, len - anchor, 0, 0);
+}
+
+static size_t get_length(const uint8_t *in, size_t len, size_t& pos) {
+	size_t ret = 0;
+	uint8_t c;
+
+	do {
+		if (pos >= len) {
+			throw std::invalid_argument("lz_decompress(): truncated length");
+		}
+
+		c = in[pos++];
+		ret += c;
+	} while (c == 255);
+
+	return ret;
+}
+
+size_t lz_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_len) {
+	size_t ip = 0, op = 0;
+
+	while (ip < len) {
+		uint8_t token = in[ip++];
+		size_t nlits = token >> 4;
+
+		if (nlits == 15) {
+			nlits += get_length(in, len, ip);
+		}
+
+		if (nlits > len - ip || nlits > out_len - op) {
+			throw std::invalid_argument("lz_decompress(): literals out of bounds");
+		}
+
+		memcpy(out + op, in + ip, nlits);
+		ip += nlits;
+		op += nlits;
+
+		if (ip == len) {
+			break;
+		}
+
+		if (len - ip < 2) {
+			throw std::invalid_argument("lz_decompress(): truncated offset");
+		}
+
+		size_t offset = in[ip] | (in[ip + 1] << 8);
+		size_t match = (token & 0xf);
+		ip += 2;
+
+		if (match == 15) {
+			match += get_length(in, len, ip);
+		}
+
+		match += LZ_MIN_MATCH;
+
+		if (offset == 0 || offset > op || match > out_len - op) {
+			throw std::invalid_argument("lz_decompress(): match out of bounds");
+		}
+
+		uint8_t *dest = out + op;
+		const uint8_t *src = dest - offset;
+
+		if (offset >= 8) {
+			// non-overlapping in 8 byte steps, the common case for entities
+			size_t k = 0;
+			for (; k + 8 <= match; k += 8) {
+				memcpy(dest + k, src + k, 8);
+			}
+
+			for (; k < match; k++) {
+				dest[k] = src[k];
+			}
+
+		} else {
+			for (size_t k = 0; k < match; k++) {
+				dest[k] = src[k];
+			}
+		}
+
+		op += match;
+	}
+
+	return op;
+}
+
+static void put_word(std::vector<uint8_t>& out, uint32_t word) {
+	word = htonl(word);
+	const uint8_t *p = (const uint8_t*)&word;
+	out.insert(out.end(), p, p + 4);
+}
+
+std::vector<uint8_t> compress_entities(const uint32_t *datas, size_t entities,
+                                       uint32_t block_entities)
+{
+	std::vector<uint8_t> ret;
+	std::vector<uint8_t> payload;
+
+	if (block_entities == 0) {
+		throw std::invalid_argument("compress_entities(): invalid block size");
+	}
+
+	for (size_t start = 0; start < entities; start += block_entities) {
+		size_t n = entities - start;
+		n = (n > block_entities)? block_entities : n;
+
+		const uint8_t *raw = (const uint8_t*)(datas + 2*start);
+		size_t raw_len = 8*n;
+
+		payload.clear();
+		lz_compress(raw, raw_len, payload);
+
+		bool stored = payload.size() >= raw_len;
+		uint32_t size = stored? raw_len : payload.size();
+
+		put_word(ret, COMPRESSED_BLOCK_MAGIC);
+		put_word(ret, start);
+		put_word(ret, n);
+		put_word(ret, size | (stored? COMPRESSED_BLOCK_STORED : 0));
+
+		if (stored) {
+			ret.insert(ret.end(), raw, raw + raw_len);
+
+		} else {
+			ret.insert(ret.end(), payload.begin(), payload.end());
+			ret.resize(ret.size() + (4 - size % 4) % 4, 0);
+		}
+	}
+
+	return ret;
+}
+
+std::vector<uint8_t> compress_entities(const std::vector<uint32_t>& datas,
+                                       uint32_t block_entities)
+{
+	return compress_entities(datas.data(), datas.size() / 2, block_entities);
+}
+
+static inline uint32_t get_word(const uint8_t *p) {
+	return ntohl(read32(p));
+}
+
+bool is_compressed(const uint8_t *buf, size_t len) {
+	return len >= COMPRESSED_BLOCK_HEADER && get_word(buf) == COMPRESSED_BLOCK_MAGIC;
+}
+
+compressed_reader::compressed_reader(const uint8_t *buf, size_t len,
+                                     size_t max_entities)
+{
+	size_t pos = 0;
+	input = buf;
+
+	while (pos < len) {
+		if (len - pos < COMPRESSED_BLOCK_HEADER
+		    || get_word(buf + pos) != COMPRESSED_BLOCK_MAGIC)
+		{
+			throw std::invalid_argument("compressed_reader: invalid block header");
+		}
+
+		block_info info;
+		uint32_t size = get_word(buf + pos + 12);
+
+		info.first_entity = get_word(buf + pos + 4);
+		info.entities     = get_word(buf + pos + 8);
+		info.offset       = pos + COMPRESSED_BLOCK_HEADER;
+		info.stored       = size & COMPRESSED_BLOCK_STORED;
+		info.payload      = size & ~COMPRESSED_BLOCK_STORED;
+
+		if (info.first_entity != total) {
+			throw std::invalid_argument("compressed_reader: block is out of order");
+		}
+
+		if (info.stored && info.payload != 8*(size_t)info.entities) {
+			throw std::invalid_argument("compressed_reader: invalid stored block");
+		}
+
+		if (8*(uint64_t)info.entities > LZ_MAX_RATIO*(uint64_t)info.payload) {
+			throw std::invalid_argument("compressed_reader: block can't hold that many entities");
+		}
+
+		if (info.entities > max_entities - total) {
+			throw std::length_error("compressed_reader: too many entities");
+		}
+
+		size_t padded = info.payload + (4 - info.payload % 4) % 4;
+		if (padded > len - info.offset) {
+			throw std::invalid_argument("compressed_reader: truncated block");
+		}
+
+		index.push_back(info);
+		total += info.entities;
+		pos = info.offset + padded;
+	}
+}
+
+size_t compressed_reader::find_block(uint32_t entity) const {
+	// blocks are contiguous and in order, so binary search on the first entity
+	size_t lo = 0, hi = index.size();
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (index[mid].first_entity + index[mid].entities <= entity) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return (lo < index.size() && index[lo].first_entity <= entity)? lo : index.size();
+}
+
+void compressed_reader::decompress_block(size_t i, uint32_t *out) const {
+	const block_info& info = index.at(i);
+	size_t raw_len = 8*(size_t)info.entities;
+
+	if (info.stored) {
+		memcpy(out, input + info.offset, raw_len);
+		return;
+	}
+
+	size_t n = lz_decompress(input + info.offset, info.payload, (uint8_t*)out, raw_len);
+
+	if (n != raw_len) {
+		throw std::invalid_argument("compressed_reader: block size mismatch");
+	}
+}
+
+std::vector<uint32_t> compressed_reader::decompress(unsigned threads) const {
+	std::vector<uint32_t> ret(2*total);
+
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+
+	threads = (threads > index.size())? index.size() : threads;
+
+	if (threads <= 1 || index.size() <= 1) {
+		for (size_t i = 0; i < index.size(); i++) {
+			decompress_block(i, ret.data() + 2*index[i].first_entity);
+		}
+
+		return ret;
+	}
+
+	// blocks are interleaved across workers, errors from workers are
+	// passed back and rethrown here
+	std::vector<std::thread> workers;
+	std::vector<std::exception_ptr> errors(threads);
+
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			try {
+				for (size_t i = t; i < index.size(); i += threads) {
+					decompress_block(i, ret.data() + 2*index[i].first_entity);
+				}
+
+			} catch (...) {
+				errors[t] = std::current_exception();
+			}
+		});
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	for (auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+
+	return ret;
+}
+
+// namespace anserial
+}
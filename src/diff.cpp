@@ -0,0 +1,440 @@
+#include <anserial/diff.hpp>
+#include <anserial/serializer.hpp>
+#include <anserial/binding.hpp>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace anserial {
+
+static const uint32_t PARENT_MASK = ~(7u << 29);
+
+// entities decoded to (tag << 32) | data
+static std::vector<uint64_t> decode_all(const uint32_t *datas, size_t entities) {
+	ent_order order = detect_order(datas, entities);
+	std::vector<uint64_t> ret(entities);
+
+	for (size_t i = 0; i < entities; i++) {
+		ret[i] = ((uint64_t)load_word(datas[2*i], order) << 32)
+		       | load_word(datas[2*i + 1], order);
+	}
+
+	return ret;
+}
+
+// parents and reference targets made relative to the entity itself, which
+// is how literal entities are stored in a patch
+static inline uint64_t relative_form(uint64_t ent, uint32_t id) {
+	uint32_t tag = ent >> 32;
+	uint32_t data = ent;
+
+	if ((tag >> 29) == ENT_TYPE_REF) {
+		data = id - data;
+	}
+
+	tag = (tag & ~PARENT_MASK) | ((id - tag) & PARENT_MASK);
+	return ((uint64_t)tag << 32) | data;
+}
+
+// where base entities end up in the target. entities copied by earlier
+// runs map to wherever they were copied, anything else (including the
+// current run) moves along with the current run. the diff and the patch
+// applier have to agree on this exactly.
+struct id_map {
+	std::vector<uint32_t> ids;
+
+	id_map(size_t entities) : ids(entities, ~0u) {}
+
+	uint32_t operator()(uint32_t id, uint32_t start, uint32_t shift) const {
+		if (id >= start || id >= ids.size() || ids[id] == ~0u) {
+			return id + shift;
+		}
+
+		return ids[id];
+	}
+};
+
+// checksum of the base document, so patches aren't applied to the wrong one
+static uint64_t base_hash(const uint32_t *datas, size_t entities) {
+	ent_order order = detect_order(datas, entities);
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < 2*entities; i++) {
+		hash = (hash ^ load_word(datas[i], order)) * 1099511628211ull;
+	}
+
+	return hash;
+}
+
+static inline uint64_t mix(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+// what windows are hashed on. parents and references close by are made
+// relative, far away ones are left out since where they point depends on
+// what was copied before, and they're checked once a window matches.
+static std::vector<uint64_t> window_keys(const std::vector<uint64_t>& ents) {
+	std::vector<uint64_t> ret(ents.size());
+
+	for (size_t i = 0; i < ents.size(); i++) {
+		uint64_t rel = relative_form(ents[i], i);
+		uint32_t tag = rel >> 32;
+		uint32_t data = rel;
+
+		if ((tag & PARENT_MASK) > PATCH_WINDOW) {
+			tag = (tag & ~PARENT_MASK) | PATCH_WINDOW;
+		}
+
+		if ((tag >> 29) == ENT_TYPE_REF && data > PATCH_WINDOW) {
+			data = PATCH_WINDOW;
+		}
+
+		ret[i] = mix(((uint64_t)tag << 32) | data);
+	}
+
+	return ret;
+}
+
+// polynomial hash of a window, so it can be rolled along one entity at a time
+static const uint64_t ROLL_BASE = 0x100000001b3ull;
+
+static uint64_t window_hash(const uint64_t *keys) {
+	uint64_t hash = 0;
+
+	for (size_t k = 0; k < PATCH_WINDOW; k++) {
+		hash = hash*ROLL_BASE + keys[k];
+	}
+
+	return hash;
+}
+
+static uint64_t roll_factor(void) {
+	uint64_t ret = 1;
+
+	for (size_t k = 1; k < PATCH_WINDOW; k++) {
+		ret *= ROLL_BASE;
+	}
+
+	return ret;
+}
+
+std::vector<uint32_t> make_patch(const uint32_t *base, size_t base_entities,
+                                 const uint32_t *target, size_t target_entities)
+{
+	std::vector<uint64_t> a = decode_all(base, base_entities);
+	std::vector<uint64_t> b = decode_all(target, target_entities);
+	std::vector<uint64_t> akeys = window_keys(a);
+	std::vector<uint64_t> bkeys = window_keys(b);
+	uint64_t check = base_hash(base, base_entities);
+
+	// only every PATCH_WINDOW'th window of the base is hashed, a run at
+	// least twice as long as a window always covers one of them
+	std::unordered_map<uint64_t, uint32_t> windows;
+	windows.reserve(a.size() / PATCH_WINDOW + 1);
+
+	for (size_t p = 0; p + PATCH_WINDOW <= a.size(); p += PATCH_WINDOW) {
+		windows.emplace(window_hash(akeys.data() + p), p);
+	}
+
+	serializer ser;
+	uint32_t top = ser.add_map(0);
+	ser.add_version(top);
+
+	ser.add_symbol(top, "::patch");
+	uint32_t header = ser.add_map(top);
+	ser.add_symbol(header, "base");
+	ser.add_integer(header, base_entities);
+	ser.add_symbol(header, "base-hash");
+	uint32_t cont = ser.add_container(header);
+	ser.add_integer(cont, check >> 32);
+	ser.add_integer(cont, check);
+	ser.add_symbol(header, "entities");
+	ser.add_integer(header, target_entities);
+	ser.add_symbol(header, "order");
+	ser.add_integer(header, detect_order(target, target_entities));
+
+	// ops go last, so they can be written without holding anything back
+	ser.symtab.emplace(hash_string("::ops"), "::ops");
+	ser.add_symtab(top);
+	ser.add_symbol(top, "::ops");
+	uint32_t ops = ser.add_container(top);
+
+	size_t lit = 0;
+	auto flush_literals = [&](size_t end) {
+		if (lit < end) {
+			uint32_t block = ser.add_container(ops);
+
+			for (size_t k = lit; k < end; k++) {
+				uint64_t rel = relative_form(b[k], k);
+				ser.add_integer(block, rel >> 32);
+				ser.add_integer(block, rel);
+			}
+		}
+	};
+
+	// whether target entity 't' is what copying base entity 's' in a run
+	// starting at 'start' would give
+	id_map map(a.size());
+
+	auto same = [&](size_t t, size_t s, uint32_t start, uint32_t shift) {
+		uint32_t ttag = b[t] >> 32, tdata = b[t];
+		uint32_t stag = a[s] >> 32, sdata = a[s];
+
+		if (((ttag ^ stag) & ~PARENT_MASK)
+		    || (map(stag & PARENT_MASK, start, shift) & PARENT_MASK) != (ttag & PARENT_MASK))
+		{
+			return false;
+		}
+
+		if ((stag >> 29) == ENT_TYPE_REF) {
+			return map(sdata, start, shift) == tdata;
+		}
+
+		return sdata == tdata;
+	};
+
+	const uint64_t factor = roll_factor();
+	uint64_t hash = 0;
+	bool have_hash = false;
+
+	for (size_t i = 0; i + PATCH_WINDOW <= b.size();) {
+		if (!have_hash) {
+			hash = window_hash(bkeys.data() + i);
+			have_hash = true;
+		}
+
+		auto it = windows.find(hash);
+		size_t src = (it != windows.end())? it->second : 0;
+		uint32_t shift = i - src;
+		size_t len = 0;
+
+		if (it != windows.end()) {
+			while (len < PATCH_WINDOW && same(i + len, src + len, src, shift)) {
+				len++;
+			}
+		}
+
+		if (len == PATCH_WINDOW) {
+			// grow the match backwards into pending literals, as long as
+			// that doesn't change where anything already matched points
+			size_t start = i;
+
+			while (start > lit && src > 0
+			       && map(src - 1, src, shift) == src - 1 + shift
+			       && same(start - 1, src - 1, src - 1, shift))
+			{
+				start--;
+				src--;
+			}
+
+			len += i - start;
+
+			while (start + len < b.size() && src + len < a.size()
+			       && same(start + len, src + len, src, shift))
+			{
+				len++;
+			}
+
+			flush_literals(start);
+			ser.add_integer(ops, src);
+			ser.add_integer(ops, len);
+
+			for (size_t k = src; k < src + len; k++) {
+				map.ids[k] = k + shift;
+			}
+
+			i = lit = start + len;
+			have_hash = false;
+			continue;
+		}
+
+		if (i + PATCH_WINDOW < b.size()) {
+			hash = (hash - bkeys[i]*factor)*ROLL_BASE + bkeys[i + PATCH_WINDOW];
+		}
+
+		i++;
+	}
+
+	flush_literals(b.size());
+	return ser.serialize();
+}
+
+std::vector<uint32_t> make_patch(const std::vector<uint32_t>& base,
+                                 const std::vector<uint32_t>& target)
+{
+	return make_patch(base.data(), base.size() / 2, target.data(), target.size() / 2);
+}
+
+// value for a key in a map, later entries win like in s_map
+static uint32_t find_value(const detail::raw_reader& r, uint32_t map, const char *key) {
+	uint32_t hash = hash_string(key);
+	uint32_t ret = ~0u;
+
+	for (uint32_t j = map + 1; j < r.entities && r.parent(j) == map;) {
+		uint32_t sym = r.data(j);
+		j = r.skip(j);
+
+		if (j >= r.entities || r.parent(j) != map) {
+			break;
+		}
+
+		if (sym == hash) {
+			ret = j;
+		}
+
+		j = r.skip(j);
+	}
+
+	return ret;
+}
+
+static uint32_t find_integer(const detail::raw_reader& r, uint32_t id) {
+	if (id >= r.entities || r.type(id) != ENT_TYPE_INTEGER) {
+		throw std::runtime_error("apply_patch(): patch header is malformed");
+	}
+
+	return r.data(id);
+}
+
+std::vector<uint32_t> apply_patch(const uint32_t *base, size_t base_entities,
+                                  const uint32_t *patch, size_t patch_entities)
+{
+	detail::raw_reader r = {patch, patch_entities, detect_order(patch, patch_entities)};
+
+	if (patch_entities == 0 || r.type(0) != ENT_TYPE_MAP) {
+		throw std::runtime_error("apply_patch(): not a patch");
+	}
+
+	uint32_t header = find_value(r, 0, "::patch");
+	uint32_t ops = find_value(r, 0, "::ops");
+
+	if (header >= patch_entities || r.type(header) != ENT_TYPE_MAP
+	    || ops >= patch_entities || r.type(ops) != ENT_TYPE_CONTAINER)
+	{
+		throw std::runtime_error("apply_patch(): not a patch");
+	}
+
+	uint32_t check = find_value(r, header, "base-hash");
+	uint64_t hash = ((uint64_t)find_integer(r, check + 1) << 32)
+	              | find_integer(r, check + 2);
+
+	if (find_integer(r, find_value(r, header, "base")) != base_entities
+	    || hash != base_hash(base, base_entities))
+	{
+		throw std::invalid_argument("apply_patch(): patch is for a different base");
+	}
+
+	size_t entities = find_integer(r, find_value(r, header, "entities"));
+	ent_order in = detect_order(base, base_entities);
+	ent_order out = (ent_order)find_integer(r, find_value(r, header, "order"));
+
+	if (out != ORDER_NETWORK && out != ORDER_NATIVE) {
+		throw std::runtime_error("apply_patch(): patch header is malformed");
+	}
+
+	// check the ops add up before allocating anything, the header could
+	// say anything
+	uint64_t total = 0;
+
+	for (uint32_t j = ops + 1; j < patch_entities && r.parent(j) == ops;) {
+		if (r.type(j) == ENT_TYPE_INTEGER && j + 1 < patch_entities) {
+			total += r.data(j + 1);
+			j += 2;
+		} else {
+			uint32_t end = r.skip(j);
+			total += (end - j - 1) / 2;
+			j = end;
+		}
+	}
+
+	if (total != entities) {
+		throw std::runtime_error("apply_patch(): ops don't add up to the target size");
+	}
+
+	std::vector<uint32_t> ret(2*entities);
+	id_map map(base_entities);
+	uint32_t pos = 0;
+
+	for (uint32_t j = ops + 1; j < patch_entities && r.parent(j) == ops;) {
+		if (r.type(j) == ENT_TYPE_INTEGER) {
+			if (j + 1 >= patch_entities || r.parent(j + 1) != ops
+			    || r.type(j + 1) != ENT_TYPE_INTEGER)
+			{
+				throw std::runtime_error("apply_patch(): copy op is malformed");
+			}
+
+			uint32_t src = r.data(j);
+			uint32_t len = r.data(j + 1);
+
+			if (src > base_entities || len > base_entities - src || len > entities - pos) {
+				throw std::runtime_error("apply_patch(): copy op is out of range");
+			}
+
+			// parents and references inside the run move along with it,
+			// ones pointing before it go wherever their target was copied
+			uint32_t shift = pos - src;
+
+			for (uint32_t k = src; k < src + len; k++) {
+				uint32_t tag = load_word(base[2*k], in);
+				uint32_t data = load_word(base[2*k + 1], in);
+
+				if ((tag >> 29) == ENT_TYPE_REF) {
+					data = map(data, src, shift);
+				}
+
+				tag = (tag & ~PARENT_MASK) | (map(tag & PARENT_MASK, src, shift) & PARENT_MASK);
+				ret[2*(k + shift)] = store_word(tag, out);
+				ret[2*(k + shift) + 1] = store_word(data, out);
+				map.ids[k] = k + shift;
+			}
+
+			pos += len;
+			j += 2;
+
+		} else if (r.type(j) == ENT_TYPE_CONTAINER) {
+			uint32_t k = j + 1;
+
+			for (; k < patch_entities && r.parent(k) == j; k += 2) {
+				if (k + 1 >= patch_entities || r.parent(k + 1) != j || pos >= entities) {
+					throw std::runtime_error("apply_patch(): literal op is malformed");
+				}
+
+				uint32_t tag = r.data(k);
+				uint32_t data = r.data(k + 1);
+
+				if ((tag >> 29) == ENT_TYPE_REF) {
+					data = pos - data;
+				}
+
+				tag = (tag & ~PARENT_MASK) | ((pos - tag) & PARENT_MASK);
+				ret[2*pos] = store_word(tag, out);
+				ret[2*pos + 1] = store_word(data, out);
+				pos++;
+			}
+
+			j = k;
+
+		} else {
+			throw std::runtime_error("apply_patch(): unknown op");
+		}
+	}
+
+	if (pos != entities) {
+		throw std::runtime_error("apply_patch(): patch ends early");
+	}
+
+	return ret;
+}
+
+std::vector<uint32_t> apply_patch(const std::vector<uint32_t>& base,
+                                  const std::vector<uint32_t>& patch)
+{
+	return apply_patch(base.data(), base.size() / 2, patch.data(), patch.size() / 2);
+}
+
+// namespace anserial
+}
@@ -0,0 +1,145 @@
+#include <anserial/framing.hpp>
+#include <stdexcept>
+#include <string>
+#include <string.h>
+#include <errno.h>
+
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <unistd.h>
+
+namespace anserial {
+
+void frame_writer::queue(const uint32_t *datas, size_t entities, uint16_t type) {
+	if (entities > 0xffffffff) {
+		throw std::invalid_argument("frame_writer::queue(): frame is too large");
+	}
+
+	frames.push_back({datas, entities});
+	headers.push_back(htonl((FRAME_MAGIC << 16) | type));
+	headers.push_back(htonl(entities));
+}
+
+void frame_writer::queue(const serializer& ser, uint16_t type) {
+	queue(ser.output.data(), ser.output.size() / 2, type);
+}
+
+void frame_writer::flush(void) {
+	// iovecs are built here rather than when queueing, since the
+	// header vector can move around as it grows
+	std::vector<struct iovec> iov;
+	iov.reserve(2*frames.size());
+
+	for (size_t i = 0; i < frames.size(); i++) {
+		iov.push_back({&headers[2*i], FRAME_HEADER});
+
+		if (frames[i].entities > 0) {
+			iov.push_back({(void*)frames[i].datas, 8*frames[i].entities});
+		}
+	}
+
+	size_t pos = 0;
+
+	while (pos < iov.size()) {
+		int count = (iov.size() - pos > IOV_MAX)? IOV_MAX : iov.size() - pos;
+		ssize_t n = writev(fd, iov.data() + pos, count);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n < 0) {
+			frames.clear();
+			headers.clear();
+			throw std::runtime_error(std::string("frame_writer: write error: ")
+			                         + strerror(errno));
+		}
+
+		// skip whatever was written, which may end partway into an iovec
+		while (pos < iov.size() && (size_t)n >= iov[pos].iov_len) {
+			n -= iov[pos++].iov_len;
+		}
+
+		if (n > 0) {
+			iov[pos].iov_base = (uint8_t*)iov[pos].iov_base + n;
+			iov[pos].iov_len -= n;
+		}
+	}
+
+	frames.clear();
+	headers.clear();
+}
+
+frame_reader::frame_reader(int nfd, size_t buffer_size) : fd(nfd) {
+	buffer.resize((buffer_size < 64)? 16 : buffer_size / 4);
+}
+
+bool frame_reader::next(frame& out) {
+	while (true) {
+		uint8_t *buf = (uint8_t*)buffer.data();
+		size_t have = end - start;
+		size_t need = FRAME_HEADER;
+
+		if (have >= FRAME_HEADER) {
+			const uint32_t *header = (const uint32_t*)(buf + start);
+			uint32_t word = ntohl(header[0]);
+			size_t entities = ntohl(header[1]);
+
+			if ((word >> 16) != FRAME_MAGIC) {
+				throw std::runtime_error("frame_reader: bad frame header");
+			}
+
+			if (entities > max_entities) {
+				throw std::length_error("frame_reader: frame is too large");
+			}
+
+			need = FRAME_HEADER + 8*entities;
+
+			if (have >= need) {
+				out.type = word & 0xffff;
+				out.datas = header + 2;
+				out.entities = entities;
+				start += need;
+				return true;
+			}
+		}
+
+		// not enough for a whole frame, so move what's left to the front
+		// and make room. frames handed out earlier are done with by now.
+		if (start > 0) {
+			memmove(buf, buf + start, have);
+			start = 0;
+			end = have;
+		}
+
+		if (need > buffer.size() * 4) {
+			buffer.resize(need / 4);
+			buf = (uint8_t*)buffer.data();
+		}
+
+		ssize_t n = read(fd, buf + end, buffer.size() * 4 - end);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n < 0) {
+			throw std::runtime_error(std::string("frame_reader: read error: ")
+			                         + strerror(errno));
+		}
+
+		if (n == 0) {
+			if (end > 0) {
+				throw std::runtime_error("frame_reader: input ends partway through a frame");
+			}
+
+			return false;
+		}
+
+		end += n;
+	}
+}
+
+// namespace anserial
+}
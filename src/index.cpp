@@ -0,0 +1,174 @@
+#include <anserial/index.hpp>
+#include <stdexcept>
+
+namespace anserial {
+
+indexed_reader::indexed_reader(const uint32_t *ndatas, size_t nentities)
+	: datas(ndatas), entities(nentities)
+{
+	load();
+}
+
+indexed_reader::indexed_reader(mapped_file& file)
+	: datas(file.words()), entities(file.entities())
+{
+	load();
+}
+
+void indexed_reader::load(void) {
+	order = detect_order(datas, entities);
+
+	if (entities < 4) {
+		throw std::runtime_error("indexed_reader: no index found");
+	}
+
+	uint32_t last = entities - 1;
+	uint32_t idx = tag(last) & ~(7 << 29);
+
+	// the trailer is only trusted if it hangs off an "::index" entry
+	// of the top-level map
+	if ((tag(last) >> 29) != ENT_TYPE_INTEGER || data(last) != INDEX_MAGIC
+	    || idx < 2 || idx >= last
+	    || tag(idx) != (uint32_t)(ENT_TYPE_CONTAINER << 29)
+	    || tag(idx - 1) != (uint32_t)(ENT_TYPE_SYMBOL << 29)
+	    || data(idx - 1) != hash_string("::index"))
+	{
+		throw std::runtime_error("indexed_reader: no index found");
+	}
+
+	uint32_t lists[2] = {npos, npos};
+	std::vector<uint32_t> values[2];
+
+	for (uint32_t i = idx + 1; i < last; i++) {
+		uint32_t parent = tag(i) & ~(7 << 29);
+
+		if (parent == idx && (tag(i) >> 29) == ENT_TYPE_CONTAINER) {
+			(lists[0] == npos? lists[0] : lists[1]) = i;
+
+		} else if ((tag(i) >> 29) == ENT_TYPE_INTEGER) {
+			if (parent == lists[0]) values[0].push_back(data(i));
+			else if (parent == lists[1]) values[1].push_back(data(i));
+		}
+	}
+
+	if (lists[1] == npos || values[0].size() % 3 || values[1].size() % 2) {
+		throw std::runtime_error("indexed_reader: malformed index");
+	}
+
+	for (size_t i = 0; i < values[0].size(); i += 3) {
+		range r = {values[0][i + 1], values[0][i + 2]};
+		top_ranges.push_back({values[0][i], r});
+	}
+
+	for (size_t i = 0; i < values[1].size(); i += 2) {
+		record_ranges.push_back({values[1][i], values[1][i + 1]});
+	}
+
+	for (auto& r : record_ranges) {
+		if (r.id >= r.end || r.end > idx) {
+			throw std::runtime_error("indexed_reader: malformed index");
+		}
+	}
+
+	for (auto& r : top_ranges) {
+		if (r.second.id >= r.second.end || r.second.end > idx) {
+			throw std::runtime_error("indexed_reader: malformed index");
+		}
+	}
+}
+
+uint32_t indexed_reader::record_id(size_t n) const {
+	return (n < record_ranges.size())? record_ranges[n].id : npos;
+}
+
+uint32_t indexed_reader::entry_id(const std::string& key) const {
+	uint32_t hash = hash_string(key);
+	uint32_t ret = npos;
+
+	// later entries win like they do in s_map
+	for (auto& r : top_ranges) {
+		if (r.first == hash) {
+			ret = r.second.id;
+		}
+	}
+
+	return ret;
+}
+
+std::vector<uint32_t> indexed_reader::record(size_t n) const {
+	if (n >= record_ranges.size()) {
+		return {};
+	}
+
+	return extract(record_ranges[n].id, record_ranges[n].end);
+}
+
+std::vector<uint32_t> indexed_reader::entry(const std::string& key) const {
+	uint32_t hash = hash_string(key);
+	const range *found = nullptr;
+
+	for (auto& r : top_ranges) {
+		if (r.first == hash) {
+			found = &r.second;
+		}
+	}
+
+	return found? extract(found->id, found->end) : std::vector<uint32_t>();
+}
+
+std::vector<uint32_t> indexed_reader::extract(uint32_t id, uint32_t end) const {
+	std::vector<uint32_t> ret;
+
+	if (id < end && end <= entities) {
+		copy_subtree(id, end, 0, ret);
+	}
+
+	return ret;
+}
+
+uint32_t indexed_reader::copy_subtree(uint32_t root, uint32_t end,
+                                      uint32_t new_parent,
+                                      std::vector<uint32_t>& out) const
+{
+	// new ID of each entity in [root, end), or npos if it's not part
+	// of the subtree
+	std::vector<uint32_t> remap(end - root, (uint32_t)npos);
+
+	for (uint32_t i = root; i < end; i++) {
+		uint32_t type = tag(i) >> 29;
+		uint32_t value = data(i);
+		uint32_t parent = tag(i) & ~(7 << 29);
+		uint32_t np = new_parent;
+
+		if (i != root) {
+			if (parent < root || parent >= i || remap[parent - root] == npos) {
+				continue;
+			}
+
+			np = remap[parent - root];
+		}
+
+		if (type == ENT_TYPE_REF) {
+			if (value >= i) {
+				throw std::out_of_range("indexed_reader: reference ID is invalid");
+			}
+
+			if (value >= root && remap[value - root] != npos) {
+				value = remap[value - root];
+
+			} else {
+				remap[i - root] = copy_subtree(value, i, np, out);
+				continue;
+			}
+		}
+
+		remap[i - root] = out.size() / 2;
+		out.push_back(htonl((type << 29) | np));
+		out.push_back(htonl(value));
+	}
+
+	return remap[0];
+}
+
+// namespace anserial
+}
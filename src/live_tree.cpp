@@ -0,0 +1,208 @@
+#include <anserial/live_tree.hpp>
+#include <stdexcept>
+
+namespace anserial {
+
+live_storage::live_storage() : chunks(new std::atomic<record*>[MAX_CHUNKS]) {
+	for (uint32_t i = 0; i < MAX_CHUNKS; i++) {
+		chunks[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	published.store(0, std::memory_order_relaxed);
+}
+
+live_storage::~live_storage() {
+	for (uint32_t i = 0; i < MAX_CHUNKS; i++) {
+		delete[] chunks[i].load(std::memory_order_relaxed);
+	}
+}
+
+live_tree::live_tree() : store(std::make_shared<live_storage>()) {}
+
+void live_tree::deserialize(const uint32_t *datas, size_t entities) {
+	if (ent_counter == 0 && detect) {
+		order = detect_order(datas, entities);
+	}
+
+	// everything written here is made visible to readers by the release
+	// store to 'published', so plain and relaxed writes are enough
+	for (size_t i = 0; i < entities; i++) {
+		uint32_t tag = load_word(datas[2*i], order);
+		uint32_t data = load_word(datas[2*i + 1], order);
+		uint32_t parent = tag & ~(7 << 29);
+		uint32_t id = ent_counter;
+
+		// only the top-level entity can be its own parent
+		if (((id == 0)? parent != 0 : parent >= id)
+		    || id >= live_storage::MAX_CHUNKS * live_storage::CHUNK_SIZE)
+		{
+			store->published.store(ent_counter, std::memory_order_release);
+			throw std::out_of_range("live_tree::deserialize(): parent ID is invalid");
+		}
+
+		if ((tag >> 29) == ENT_TYPE_REF && data >= id) {
+			store->published.store(ent_counter, std::memory_order_release);
+			throw std::out_of_range("live_tree::deserialize(): reference ID is invalid");
+		}
+
+		auto& chunk = store->chunks[id >> live_storage::CHUNK_BITS];
+		if (!chunk.load(std::memory_order_relaxed)) {
+			chunk.store(new live_storage::record[live_storage::CHUNK_SIZE],
+			            std::memory_order_relaxed);
+		}
+
+		live_storage::record& rec = store->at(id);
+		rec.tag = tag;
+		rec.data = data;
+		rec.first_child.store(live_storage::npos, std::memory_order_relaxed);
+		rec.next_sibling.store(live_storage::npos, std::memory_order_relaxed);
+		rec.last_child = live_storage::npos;
+
+		// the top-level entity is its own parent, don't link it to itself
+		if (id > 0) {
+			live_storage::record& p = store->at(parent);
+
+			if (p.last_child == live_storage::npos) {
+				p.first_child.store(id, std::memory_order_relaxed);
+			} else {
+				store->at(p.last_child).next_sibling.store(id, std::memory_order_relaxed);
+			}
+
+			p.last_child = id;
+		}
+
+		ent_counter++;
+	}
+
+	store->published.store(ent_counter, std::memory_order_release);
+}
+
+void live_tree::deserialize(const std::vector<uint32_t>& datas) {
+	deserialize(datas.data(), datas.size() / 2);
+}
+
+live_snapshot live_tree::snapshot(void) const {
+	return live_snapshot(store, store->published.load(std::memory_order_acquire));
+}
+
+uint32_t live_snapshot::resolve(uint32_t id) const {
+	while (id < count && (store->at(id).tag >> 29) == ENT_TYPE_REF) {
+		id = store->at(id).data;
+	}
+
+	return visible(id);
+}
+
+uint32_t live_snapshot::type(uint32_t id) const {
+	id = resolve(id);
+	return (id != npos)? store->at(id).tag >> 29 : (uint32_t)ENT_TYPE_NULL;
+}
+
+uint32_t live_snapshot::parent(uint32_t id) const {
+	return (id < count)? store->at(id).tag & ~(7 << 29) : npos;
+}
+
+bool live_snapshot::uint(uint32_t id, uint32_t& out) const {
+	uint32_t t = type(id);
+
+	if (t != ENT_TYPE_INTEGER && t != ENT_TYPE_SYMBOL) {
+		return false;
+	}
+
+	out = store->at(resolve(id)).data;
+	return true;
+}
+
+std::string live_snapshot::string(uint32_t id) const {
+	std::string ret;
+
+	if (type(id) != ENT_TYPE_STRING) {
+		return ret;
+	}
+
+	for (uint32_t c = first_child(id); c != npos; c = next_sibling(c)) {
+		if (type(c) == ENT_TYPE_INTEGER) {
+			ret += store->at(c).data;
+		}
+	}
+
+	return ret;
+}
+
+uint32_t live_snapshot::first_child(uint32_t id) const {
+	id = resolve(id);
+
+	if (id == npos) {
+		return npos;
+	}
+
+	// links past the end of the snapshot were added after it was taken
+	return visible(store->at(id).first_child.load(std::memory_order_relaxed));
+}
+
+uint32_t live_snapshot::next_sibling(uint32_t id) const {
+	if (id >= count) {
+		return npos;
+	}
+
+	return visible(store->at(id).next_sibling.load(std::memory_order_relaxed));
+}
+
+uint32_t live_snapshot::get(uint32_t id, uint32_t index) const {
+	uint32_t t = type(id);
+	uint32_t pos = 0;
+
+	if (t != ENT_TYPE_CONTAINER && t != ENT_TYPE_MAP && t != ENT_TYPE_SET) {
+		return npos;
+	}
+
+	for (uint32_t c = first_child(id); c != npos; c = next_sibling(c), pos++) {
+		// map keys are on even positions, values on odd positions
+		if ((t == ENT_TYPE_MAP)? (pos % 2 == 1 && pos/2 == index) : pos == index) {
+			return c;
+		}
+	}
+
+	return npos;
+}
+
+uint32_t live_snapshot::get(uint32_t id, const std::string& symbol) const {
+	return get_hash(id, hash_string(symbol));
+}
+
+uint32_t live_snapshot::get_hash(uint32_t id, uint32_t hash) const {
+	if (type(id) != ENT_TYPE_MAP) {
+		return npos;
+	}
+
+	uint32_t ret = npos;
+
+	// keep going after a match, so later entries win like they do in s_map
+	for (uint32_t k = first_child(id); k != npos; k = next_sibling(k)) {
+		uint32_t v = next_sibling(k);
+
+		if (v == npos) {
+			break;
+		}
+
+		if (store->at(k).data == hash) {
+			ret = v;
+		}
+
+		k = v;
+	}
+
+	return ret;
+}
+
+uint32_t live_snapshot::data(void) const {
+	uint32_t ret = get_hash(top(), hash_string("::data"));
+	return (ret != npos)? ret : top();
+}
+
+uint32_t live_snapshot::lookup(uint32_t hash) const {
+	return get_hash(get_hash(top(), hash_string("::symtab")), hash);
+}
+
+// namespace anserial
+}
@@ -0,0 +1,67 @@
+#include <anserial/mapped_file.hpp>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace anserial {
+
+mapped_file::mapped_file(const std::string& path, bool nwritable) {
+	writable = nwritable;
+	fd = open(path.c_str(), writable? O_RDWR : O_RDONLY);
+
+	if (fd < 0) {
+		throw std::runtime_error("mapped_file: couldn't open " + path
+		                         + ": " + strerror(errno));
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int err = errno;
+		close(fd);
+		throw std::runtime_error("mapped_file: couldn't stat " + path
+		                         + ": " + strerror(err));
+	}
+
+	length = st.st_size;
+
+	// mmap() doesn't accept empty mappings, leave those as a null buffer
+	if (length == 0) {
+		return;
+	}
+
+	int prot = PROT_READ | (writable? PROT_WRITE : 0);
+	void *ptr = mmap(nullptr, length, prot, MAP_SHARED, fd, 0);
+
+	if (ptr == MAP_FAILED) {
+		int err = errno;
+		close(fd);
+		throw std::runtime_error("mapped_file: couldn't map " + path
+		                         + ": " + strerror(err));
+	}
+
+	addr = (uint8_t*)ptr;
+}
+
+mapped_file::~mapped_file() {
+	if (addr) {
+		munmap(addr, length);
+	}
+
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+void mapped_file::sync() {
+	if (addr && writable && msync(addr, length, MS_SYNC) < 0) {
+		throw std::runtime_error(std::string("mapped_file::sync(): ") + strerror(errno));
+	}
+}
+
+// namespace anserial
+}
@@ -0,0 +1,196 @@
+#include <anserial/mutable_view.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace anserial {
+
+mutable_view::mutable_view(uint32_t *datas, size_t entities)
+	: mutable_view(datas, entities, detect_order(datas, entities)) {}
+
+mutable_view::mutable_view(uint32_t *datas, size_t entities, ent_order norder) {
+	words = datas;
+	count = entities;
+	order = norder;
+}
+
+mutable_view::mutable_view(mapped_file& file)
+	: mutable_view(file.words(), file.entities()) {}
+
+uint32_t mutable_view::type(uint32_t id) const {
+	if (id >= count) {
+		throw std::out_of_range("mutable_view::type(): invalid ID " + std::to_string(id));
+	}
+
+	return load_word(words[2*id], order) >> 29;
+}
+
+uint32_t mutable_view::parent(uint32_t id) const {
+	if (id >= count) {
+		throw std::out_of_range("mutable_view::parent(): invalid ID " + std::to_string(id));
+	}
+
+	return load_word(words[2*id], order) & ~(7 << 29);
+}
+
+uint32_t mutable_view::data(uint32_t id) const {
+	if (id >= count) {
+		throw std::out_of_range("mutable_view::data(): invalid ID " + std::to_string(id));
+	}
+
+	return load_word(words[2*id + 1], order);
+}
+
+template <typename F>
+uint32_t mutable_view::find_child(uint32_t id, F fn) const {
+	if (!child_start.empty()) {
+		for (uint32_t k = child_start[id]; k < child_start[id + 1]; k++) {
+			if (fn(child_ids[k])) {
+				return child_ids[k];
+			}
+		}
+
+		return NO_ENTITY;
+	}
+
+	// children always come after their parent, so only the rest of
+	// the buffer needs to be searched
+	for (size_t i = id + 1; i < count; i++) {
+		if ((load_word(words[2*i], order) & ~(7 << 29)) == id && fn(i)) {
+			return i;
+		}
+	}
+
+	return NO_ENTITY;
+}
+
+uint32_t mutable_view::child(uint32_t id, uint32_t index) const {
+	bool is_map = type(id) == ENT_TYPE_MAP;
+	uint32_t pos = 0;
+
+	uint32_t ret = find_child(id, [&](uint32_t) {
+		// map keys are on even positions, values on odd positions
+		bool match = (is_map? pos/2 == index && pos % 2 == 1 : pos == index);
+		pos++;
+		return match;
+	});
+
+	if (ret == NO_ENTITY) {
+		throw std::out_of_range("mutable_view::child(): invalid index "
+		                        + std::to_string(index));
+	}
+
+	return ret;
+}
+
+uint32_t mutable_view::lookup(uint32_t id, const std::string& key) const {
+	return lookup(id, hash_string(key));
+}
+
+uint32_t mutable_view::lookup(uint32_t id, uint32_t hash) const {
+	if (type(id) != ENT_TYPE_MAP) {
+		throw std::logic_error("mutable_view::lookup(): entity "
+		                       + std::to_string(id) + " is not a map");
+	}
+
+	uint32_t pos = 0;
+	bool found = false;
+
+	uint32_t ret = find_child(id, [&](uint32_t child) {
+		if (found) {
+			return true;
+		}
+
+		if (pos++ % 2 == 0 && data(child) == hash) {
+			found = true;
+		}
+
+		return false;
+	});
+
+	if (ret == NO_ENTITY) {
+		throw std::out_of_range("mutable_view::lookup(): no entry for symbol");
+	}
+
+	return ret;
+}
+
+uint32_t mutable_view::resolve(const std::vector<ent_int>& path, uint32_t from) const {
+	uint32_t cur = from;
+
+	for (const ent_int& step : path) {
+		if (type(cur) == ENT_TYPE_REF) {
+			// writing through a reference would change every copy
+			throw std::logic_error("mutable_view::resolve(): path goes through "
+			                       "a shared reference");
+		}
+
+		switch (step.d_type) {
+			case ENT_TYPE_SYMBOL:
+				cur = lookup(cur, step.datas.s_str);
+				break;
+
+			case ENT_TYPE_INTEGER:
+				cur = child(cur, step.datas.i);
+				break;
+
+			default:
+				throw std::invalid_argument("mutable_view::resolve(): path steps must "
+				                            "be symbols or integers");
+		}
+	}
+
+	return cur;
+}
+
+void mutable_view::set_uint(uint32_t id, uint32_t value) {
+	if (type(id) != ENT_TYPE_INTEGER) {
+		throw std::logic_error("mutable_view::set_uint(): entity "
+		                       + std::to_string(id) + " is not an integer");
+	}
+
+	words[2*id + 1] = store_word(value, order);
+}
+
+void mutable_view::apply(const std::vector<update>& updates) {
+	for (const update& u : updates) {
+		if (type(u.id) != ENT_TYPE_INTEGER) {
+			throw std::logic_error("mutable_view::apply(): entity "
+			                       + std::to_string(u.id) + " is not an integer");
+		}
+	}
+
+	for (const update& u : updates) {
+		words[2*u.id + 1] = store_word(u.value, order);
+	}
+}
+
+void mutable_view::index_children() {
+	child_start.assign(count + 1, 0);
+
+	// counting sort on parent IDs, the root is its own parent so skip it
+	for (size_t i = 1; i < count; i++) {
+		uint32_t p = load_word(words[2*i], order) & ~(7 << 29);
+
+		if (p < count) {
+			child_start[p + 1]++;
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		child_start[i + 1] += child_start[i];
+	}
+
+	std::vector<uint32_t> fill(child_start.begin(), child_start.end() - 1);
+	child_ids.resize(child_start[count]);
+
+	for (size_t i = 1; i < count; i++) {
+		uint32_t p = load_word(words[2*i], order) & ~(7 << 29);
+
+		if (p < count) {
+			child_ids[fill[p]++] = i;
+		}
+	}
+}
+
+// namespace anserial
+}
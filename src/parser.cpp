@@ -1,10 +1,12 @@
 #include <anserial/parser.hpp>
+#include <anserial/stats.hpp>
 #include <string.h>
 #include <iostream>
 
 using namespace anserial;
 
 s_tree sexp_parser::parse(void) {
+	ANSERIAL_STAT_TIMER(parse_ns);
 	token foo = parse_top();
 	return s_tree(foo.node);
 }
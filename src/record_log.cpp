@@ -0,0 +1,415 @@
+#include <anserial/record_log.hpp>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include <arpa/inet.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace anserial {
+
+static void store_be64(uint32_t *words, uint64_t value) {
+	words[0] = htonl(value >> 32);
+	words[1] = htonl(value & 0xffffffff);
+}
+
+static uint64_t load_be64(const uint32_t *words) {
+	return ((uint64_t)ntohl(words[0]) << 32) | ntohl(words[1]);
+}
+
+static std::runtime_error log_error(const std::string& what, const std::string& path) {
+	return std::runtime_error("record_log: " + what + " " + path + ": " + strerror(errno));
+}
+
+// takes the lock every writer holds on its log, so only one can append to
+// it at a time and compact_log() can tell when nobody is
+static void lock_log(int fd, const std::string& path) {
+	while (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+		if (errno == EWOULDBLOCK) {
+			throw std::runtime_error("record_log: " + path + " is open for writing elsewhere");
+		}
+
+		if (errno != EINTR) {
+			throw log_error("couldn't lock", path);
+		}
+	}
+}
+
+record_log_writer::record_log_writer(const std::string& npath) : path(npath) {
+	log_fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+
+	if (log_fd < 0) {
+		throw log_error("couldn't open", path);
+	}
+
+	try {
+		lock_log(log_fd, path);
+
+	} catch (...) {
+		close(log_fd);
+		throw;
+	}
+
+	idx_fd = open((path + ".idx").c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+
+	if (idx_fd < 0) {
+		int err = errno;
+		close(log_fd);
+		errno = err;
+		throw log_error("couldn't open", path + ".idx");
+	}
+
+	try {
+		recover();
+
+	} catch (...) {
+		close(log_fd);
+		close(idx_fd);
+		throw;
+	}
+}
+
+record_log_writer::~record_log_writer() {
+	close(log_fd);
+	close(idx_fd);
+}
+
+// brings the index up to date with the log, and drops any partially
+// written record at the end of the log
+void record_log_writer::recover(void) {
+	struct stat log_st, idx_st;
+
+	if (fstat(log_fd, &log_st) < 0 || fstat(idx_fd, &idx_st) < 0) {
+		throw log_error("couldn't stat", path);
+	}
+
+	uint64_t size = log_st.st_size;
+	uint64_t pos = 0;
+	count = idx_st.st_size / LOG_INDEX_ENTRY;
+
+	if (count > 0) {
+		uint32_t entry[4], header[4];
+		uint64_t offset = 0, timestamp = 0;
+
+		if (pread(idx_fd, entry, sizeof(entry), (count - 1) * LOG_INDEX_ENTRY) == sizeof(entry)) {
+			offset = load_be64(entry);
+			timestamp = load_be64(entry + 2);
+		}
+
+		if (offset + LOG_FRAME_HEADER <= size
+		    && pread(log_fd, header, sizeof(header), offset) == sizeof(header)
+		    && ntohl(header[0]) == LOG_FRAME_MAGIC
+		    && load_be64(header + 2) == timestamp
+		    && offset + LOG_FRAME_HEADER + 8ull*ntohl(header[1]) <= size)
+		{
+			pos = offset + LOG_FRAME_HEADER + 8ull*ntohl(header[1]);
+			last_timestamp = timestamp;
+
+		} else {
+			// index doesn't match the log, rebuild it from scratch
+			count = 0;
+		}
+	}
+
+	if ((uint64_t)idx_st.st_size != count * LOG_INDEX_ENTRY
+	    && ftruncate(idx_fd, count * LOG_INDEX_ENTRY) < 0)
+	{
+		throw log_error("couldn't truncate", path + ".idx");
+	}
+
+	while (pos + LOG_FRAME_HEADER <= size) {
+		uint32_t header[4];
+
+		if (pread(log_fd, header, sizeof(header), pos) != sizeof(header)) {
+			throw log_error("couldn't read", path);
+		}
+
+		if (ntohl(header[0]) != LOG_FRAME_MAGIC) {
+			throw std::runtime_error("record_log: corrupt frame header in " + path);
+		}
+
+		uint64_t end = pos + LOG_FRAME_HEADER + 8ull*ntohl(header[1]);
+
+		if (end > size) {
+			break;
+		}
+
+		uint32_t entry[4];
+		store_be64(entry, pos);
+		entry[2] = header[2];
+		entry[3] = header[3];
+		write_all(idx_fd, entry, sizeof(entry));
+
+		last_timestamp = load_be64(header + 2);
+		count++;
+		pos = end;
+	}
+
+	if (pos < size && ftruncate(log_fd, pos) < 0) {
+		throw log_error("couldn't truncate", path);
+	}
+
+	log_size = pos;
+}
+
+void record_log_writer::write_all(int fd, const void *buf, size_t len) {
+	const uint8_t *p = (const uint8_t*)buf;
+
+	while (len > 0) {
+		ssize_t n = write(fd, p, len);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			throw log_error("couldn't write to", path);
+		}
+
+		p += n;
+		len -= n;
+	}
+}
+
+uint64_t record_log_writer::append(const uint32_t *datas, size_t entities,
+                                   uint64_t timestamp)
+{
+	if (count > 0 && timestamp < last_timestamp) {
+		throw std::invalid_argument("record_log_writer::append(): timestamp is older "
+		                            "than the last record's");
+	}
+
+	if (entities > 0xffffffff) {
+		throw std::invalid_argument("record_log_writer::append(): record is too large");
+	}
+
+	uint32_t header[4] = {htonl(LOG_FRAME_MAGIC), htonl(entities)};
+	store_be64(header + 2, timestamp);
+
+	// header and record in one call where possible, finishing off
+	// short writes by hand
+	struct iovec iov[2] = {
+		{header, sizeof(header)},
+		{(void*)datas, 8*entities},
+	};
+
+	size_t total = sizeof(header) + 8*entities;
+	ssize_t n;
+
+	do {
+		n = writev(log_fd, iov, 2);
+	} while (n < 0 && errno == EINTR);
+
+	if (n < 0) {
+		throw log_error("couldn't write to", path);
+	}
+
+	if ((size_t)n < sizeof(header)) {
+		write_all(log_fd, (uint8_t*)header + n, sizeof(header) - n);
+		write_all(log_fd, datas, 8*entities);
+
+	} else if ((size_t)n < total) {
+		write_all(log_fd, (uint8_t*)datas + (n - sizeof(header)), total - n);
+	}
+
+	uint32_t entry[4];
+	store_be64(entry, log_size);
+	store_be64(entry + 2, timestamp);
+	write_all(idx_fd, entry, sizeof(entry));
+
+	log_size += total;
+	last_timestamp = timestamp;
+	return count++;
+}
+
+uint64_t record_log_writer::append(const serializer& ser, uint64_t timestamp) {
+	return append(ser.output.data(), ser.output.size() / 2, timestamp);
+}
+
+void record_log_writer::sync(void) {
+	if (fsync(log_fd) < 0 || fsync(idx_fd) < 0) {
+		throw log_error("couldn't sync", path);
+	}
+}
+
+record_log::record_log(const std::string& path) {
+	log.reset(new mapped_file(path));
+
+	// a missing index just means scanning the whole log
+	try {
+		idx.reset(new mapped_file(path + ".idx"));
+		indexed = idx->size() / LOG_INDEX_ENTRY;
+
+	} catch (const std::runtime_error&) {
+		indexed = 0;
+	}
+
+	uint64_t pos = 0;
+
+	if (indexed > 0) {
+		entry first = index_entry(0);
+		entry last = index_entry(indexed - 1);
+
+		if (first.offset == 0
+		    && valid_frame(first.offset, first.timestamp)
+		    && valid_frame(last.offset, last.timestamp))
+		{
+			const uint32_t *header = (const uint32_t*)(log->data() + last.offset);
+			pos = last.offset + LOG_FRAME_HEADER + 8ull*ntohl(header[1]);
+
+		} else {
+			indexed = 0;
+		}
+	}
+
+	// pick up records written after the index was last updated
+	while (pos + LOG_FRAME_HEADER <= log->size()) {
+		const uint32_t *header = (const uint32_t*)(log->data() + pos);
+
+		if (ntohl(header[0]) != LOG_FRAME_MAGIC) {
+			throw std::runtime_error("record_log: corrupt frame header in " + path);
+		}
+
+		uint64_t end = pos + LOG_FRAME_HEADER + 8ull*ntohl(header[1]);
+
+		if (end > log->size()) {
+			break;
+		}
+
+		tail.push_back({pos, load_be64(header + 2)});
+		pos = end;
+	}
+}
+
+record_log::entry record_log::index_entry(size_t n) const {
+	if (n < indexed) {
+		const uint32_t *words = (const uint32_t*)(idx->data() + n*LOG_INDEX_ENTRY);
+		return {load_be64(words), load_be64(words + 2)};
+	}
+
+	return tail[n - indexed];
+}
+
+bool record_log::valid_frame(uint64_t offset, uint64_t timestamp) const {
+	if (offset % 8 || offset + LOG_FRAME_HEADER > log->size()) {
+		return false;
+	}
+
+	const uint32_t *header = (const uint32_t*)(log->data() + offset);
+
+	return ntohl(header[0]) == LOG_FRAME_MAGIC
+	    && load_be64(header + 2) == timestamp
+	    && offset + LOG_FRAME_HEADER + 8ull*ntohl(header[1]) <= log->size();
+}
+
+record_log::record record_log::get(size_t n) const {
+	if (n >= size()) {
+		throw std::out_of_range("record_log::get(): record number is invalid");
+	}
+
+	entry e = index_entry(n);
+	const uint32_t *header = (const uint32_t*)(log->data() + e.offset);
+
+	return {header + LOG_FRAME_HEADER/4, ntohl(header[1]), e.timestamp};
+}
+
+size_t record_log::find(uint64_t timestamp) const {
+	size_t low = 0, high = size();
+
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (index_entry(mid).timestamp < timestamp) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+// makes renames and unlinks in the directory holding 'path' durable
+static void sync_dir(const std::string& path) {
+	size_t slash = path.rfind('/');
+	std::string dir = (slash == std::string::npos)? "."
+	                : (slash == 0)? "/" : path.substr(0, slash);
+
+	int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+
+	if (fd < 0) {
+		throw log_error("couldn't open", dir);
+	}
+
+	int ret = fsync(fd);
+	int err = errno;
+	close(fd);
+
+	if (ret < 0) {
+		errno = err;
+		throw log_error("couldn't sync", dir);
+	}
+}
+
+void compact_log(const std::string& path, uint64_t before) {
+	std::string tmp = path + ".compact";
+	unlink(tmp.c_str());
+	unlink((tmp + ".idx").c_str());
+
+	// held until the new log is in place, so no writer can open the old
+	// one and append records that would be lost with it
+	int lock_fd = open(path.c_str(), O_RDONLY);
+
+	if (lock_fd < 0) {
+		throw log_error("couldn't open", path);
+	}
+
+	try {
+		lock_log(lock_fd, path);
+
+		// kept open until both renames are done, its lock moves over
+		// with the log and keeps new writers out until the index is
+		// there as well
+		record_log_writer out(tmp);
+
+		{
+			record_log old(path);
+
+			for (size_t i = old.find(before); i < old.size(); i++) {
+				record_log::record r = old.get(i);
+				out.append(r.datas, r.entities, r.timestamp);
+			}
+		}
+
+		out.sync();
+
+		// the old index goes first, so there's never an index beside a
+		// log it doesn't belong to. a crash in between leaves a log
+		// without one, which readers scan and writers rebuild.
+		if (unlink((path + ".idx").c_str()) < 0 && errno != ENOENT) {
+			throw log_error("couldn't remove", path + ".idx");
+		}
+
+		if (rename(tmp.c_str(), path.c_str()) < 0
+		    || rename((tmp + ".idx").c_str(), (path + ".idx").c_str()) < 0)
+		{
+			throw log_error("couldn't replace", path);
+		}
+
+		sync_dir(path);
+
+	} catch (...) {
+		close(lock_fd);
+		throw;
+	}
+
+	close(lock_fd);
+}
+
+// namespace anserial
+}
@@ -0,0 +1,23 @@
+#include <anserial/s_node.hpp>
+#include <anserial/stats.hpp>
+
+namespace anserial {
+
+s_node::s_node() {
+	ANSERIAL_STAT_ADD(nodes_allocated, 1);
+}
+
+s_node::~s_node() {
+	ANSERIAL_STAT_ADD(nodes_freed, 1);
+}
+
+s_node* s_map::try_get(uint32_t symbol) {
+	auto it = entries.find(symbol);
+	s_node *ret = (it != entries.end())? it->second : nullptr;
+	ANSERIAL_STAT_ADD(map_hits, ret != nullptr);
+	ANSERIAL_STAT_ADD(map_misses, ret == nullptr);
+	return ret;
+}
+
+// namespace anserial
+}
@@ -36,6 +36,10 @@ s_node *s_tree::lookup(uint32_t hash) {
 }
 
 void s_tree::refresh(void) {
+	if (frozen) {
+		return;
+	}
+
 	if (!cached.top && der) {
 		cached.top = der->deserialize();
 	}
@@ -47,11 +51,41 @@ void s_tree::refresh(void) {
 	}
 }
 
+void s_tree::sync_symbols(void) {
+	if (frozen) {
+		return;
+	}
+
+	size_t entries = cached.symtab? cached.symtab->entities().size() : 0;
+
+	if (cached.symtab != syms_node || entries != syms_entries) {
+		syms.load(cached.symtab);
+		syms_node = cached.symtab;
+		syms_entries = entries;
+	}
+}
+
+void s_tree::freeze(void) {
+	// nothing can be loaded lazily once frozen
+	refresh();
+	sync_symbols();
+
+	if (der) {
+		der->freeze();
+	}
+
+	frozen = true;
+}
+
 void s_tree::dump_nodes(void) {
 	dump_nodes(cached.top, 0);
 }
 
 void s_tree::dump_nodes(s_node *node, unsigned indent) {
+	if (indent == 0) {
+		sync_symbols();
+	}
+
 	if (!node) {
 		printf("#<nullptr>");
 		return;
@@ -81,27 +115,54 @@ void s_tree::dump_nodes(s_node *node, unsigned indent) {
 			break;
 
 		case ENT_TYPE_MAP:
-			printf("(map");
-			for (auto& x : node->keys()) {
-				putchar('\n');
+			{
+				// keys are resolved all at once, rather than one lookup at a time
+				std::vector<std::string_view> names;
+				syms.resolve(node, names);
+
+				printf("(map");
+				for (size_t i = 0; i < names.size(); i++) {
+					s_node *x = node->keys()[i];
+					putchar('\n');
+
+					if (names[i].data()) {
+						printf("%*s%.*s ", 4*(indent + 1), " ",
+						       (int)names[i].size(), names[i].data());
+					} else {
+						dump_nodes(x, indent + 1);
+					}
+
+					dump_nodes(node->get(x->uint()), indent + 1);
+				}
+				putchar(')');
+			}
+
+			break;
 
+		case ENT_TYPE_SET:
+			printf("(set");
+			for (auto& x : node->entities()) {
+				putchar('\n');
 				dump_nodes(x, indent + 1);
-				dump_nodes(node->get(x->uint()), indent + 1);
 			}
 			putchar(')');
 
 			break;
 
+		case ENT_TYPE_NULL:
+			printf("#<null>");
+			break;
+
 		case ENT_TYPE_STRING:
 			std::cout << '"' << node->string() << '"';
 			break;
 
 		case ENT_TYPE_SYMBOL:
 			{
-				s_node *str = lookup(node->uint());
+				std::string_view str;
 
-				if (str) {
-					std::cout << str->string() << ' ';
+				if (syms.find(node->uint(), str)) {
+					std::cout << str << ' ';
 
 				} else {
 					printf("#<symbol:#x%x>", node->uint());
@@ -0,0 +1,93 @@
+#include <anserial/stats.hpp>
+#include <anserial/base_ent.hpp>
+
+namespace anserial {
+
+// static storage, so everything starts out zeroed
+stat_counters counters;
+
+bool stats_enabled(void) {
+#if defined(ANSERIAL_STATS)
+	return true;
+#else
+	return false;
+#endif
+}
+
+stats get_stats(void) {
+	stats ret;
+
+	for (unsigned i = 0; i < 8; i++) {
+		ret.entities_in[i]  = counters.entities_in[i].load(std::memory_order_relaxed);
+		ret.entities_out[i] = counters.entities_out[i].load(std::memory_order_relaxed);
+	}
+
+	ret.bytes_in        = counters.bytes_in.load(std::memory_order_relaxed);
+	ret.bytes_out       = counters.bytes_out.load(std::memory_order_relaxed);
+	ret.nodes_allocated = counters.nodes_allocated.load(std::memory_order_relaxed);
+	ret.nodes_freed     = counters.nodes_freed.load(std::memory_order_relaxed);
+	ret.map_hits        = counters.map_hits.load(std::memory_order_relaxed);
+	ret.map_misses      = counters.map_misses.load(std::memory_order_relaxed);
+	ret.symtab_entries  = counters.symtab_entries.load(std::memory_order_relaxed);
+	ret.add_ent_ns      = counters.add_ent_ns.load(std::memory_order_relaxed);
+	ret.deserialize_ns  = counters.deserialize_ns.load(std::memory_order_relaxed);
+	ret.parse_ns        = counters.parse_ns.load(std::memory_order_relaxed);
+
+	return ret;
+}
+
+void stat_add_out(uint32_t type, uint64_t entities) {
+	ANSERIAL_STAT_ADD(entities_out[type & 7], entities);
+	ANSERIAL_STAT_ADD(bytes_out, 8*entities);
+}
+
+void reset_stats(void) {
+	for (unsigned i = 0; i < 8; i++) {
+		counters.entities_in[i] = 0;
+		counters.entities_out[i] = 0;
+	}
+
+	counters.bytes_in = 0;
+	counters.bytes_out = 0;
+	counters.nodes_allocated = 0;
+	counters.nodes_freed = 0;
+	counters.map_hits = 0;
+	counters.map_misses = 0;
+	counters.symtab_entries = 0;
+	counters.add_ent_ns = 0;
+	counters.deserialize_ns = 0;
+	counters.parse_ns = 0;
+}
+
+void dump_stats(FILE *fp) {
+	static const char *types[] = {
+		"container", "symbol", "integer", "string",
+		"map", "set", "null", "ref",
+	};
+
+	stats s = get_stats();
+
+	if (!stats_enabled()) {
+		fprintf(fp, "; stats: disabled, rebuild with ANSERIAL_STATS defined\n");
+		return;
+	}
+
+	fprintf(fp, "; stats: %-16s %14s %14s\n", "entity type", "in", "out");
+	for (unsigned i = 0; i < 8; i++) {
+		fprintf(fp, "; stats: %-16s %14lu %14lu\n", types[i],
+		        (unsigned long)s.entities_in[i], (unsigned long)s.entities_out[i]);
+	}
+
+	fprintf(fp, "; stats: bytes in: %lu, bytes out: %lu\n",
+	        (unsigned long)s.bytes_in, (unsigned long)s.bytes_out);
+	fprintf(fp, "; stats: nodes allocated: %lu, freed: %lu\n",
+	        (unsigned long)s.nodes_allocated, (unsigned long)s.nodes_freed);
+	fprintf(fp, "; stats: map lookups: %lu hits, %lu misses\n",
+	        (unsigned long)s.map_hits, (unsigned long)s.map_misses);
+	fprintf(fp, "; stats: symtab entries: %lu\n", (unsigned long)s.symtab_entries);
+	fprintf(fp, "; stats: time in add_ent: %.3fms, deserialize: %.3fms, parser: %.3fms\n",
+	        s.add_ent_ns / 1e6, s.deserialize_ns / 1e6, s.parse_ns / 1e6);
+}
+
+// namespace anserial
+}
@@ -0,0 +1,242 @@
+#include <anserial/stream_reader.hpp>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace anserial {
+
+stream_reader::stream_reader(int nfd, size_t nblock_size, bool nread_ahead)
+	: fd(nfd), block_size(nblock_size), read_ahead(nread_ahead)
+{
+	start();
+}
+
+stream_reader::stream_reader(FILE *nfp, size_t nblock_size, bool nread_ahead)
+	: fp(nfp), block_size(nblock_size), read_ahead(nread_ahead)
+{
+	start();
+}
+
+stream_reader::~stream_reader() {
+	if (reader.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+
+		cond.notify_all();
+
+		// wakes a read blocked on the descriptor
+		if (wake[1] >= 0) {
+			char c = 0;
+			while (write(wake[1], &c, 1) < 0 && errno == EINTR);
+		}
+
+		reader.join();
+	}
+
+	if (wake[0] >= 0) {
+		close(wake[0]);
+		close(wake[1]);
+	}
+}
+
+void stream_reader::start(void) {
+	// whole entities, with room in front for a carried over partial one
+	block_size = (block_size < 8)? 8 : block_size & ~(size_t)7;
+
+	for (slot& s : slots) {
+		s.buf.resize((block_size + 8) / 4);
+	}
+
+	if (read_ahead) {
+		if (fd >= 0 && pipe(wake) < 0) {
+			throw std::runtime_error(std::string("stream_reader: couldn't create pipe: ")
+			                         + strerror(errno));
+		}
+
+		reader = std::thread(&stream_reader::produce, this);
+	}
+}
+
+size_t stream_reader::read_some(uint8_t *buf, size_t len) {
+	if (fp) {
+		size_t n = fread(buf, 1, len, fp);
+
+		if (n == 0 && ferror(fp)) {
+			throw std::runtime_error(std::string("stream_reader: read error: ")
+			                         + strerror(errno));
+		}
+
+		return n;
+	}
+
+	while (true) {
+		// with read-ahead, wait for input or for the destructor, and
+		// end the input early for the latter
+		if (wake[0] >= 0) {
+			struct pollfd fds[2] = {{fd, POLLIN, 0}, {wake[0], POLLIN, 0}};
+
+			if (poll(fds, 2, -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+
+				throw std::runtime_error(std::string("stream_reader: poll error: ")
+				                         + strerror(errno));
+			}
+
+			if (fds[1].revents) {
+				return 0;
+			}
+		}
+
+		ssize_t n = read(fd, buf, len);
+
+		if (n >= 0) {
+			return n;
+		}
+
+		if (errno != EINTR) {
+			throw std::runtime_error(std::string("stream_reader: read error: ")
+			                         + strerror(errno));
+		}
+	}
+}
+
+// reads into a slot until there's at least one whole entity or the input
+// ends. reads are handed over as soon as they return rather than waiting
+// for a full block, so slow writers don't add latency.
+void stream_reader::fill(slot& s) {
+	uint8_t *buf = (uint8_t*)s.buf.data();
+	size_t have = ncarry;
+
+	memcpy(buf, carry, ncarry);
+	s.eof = false;
+
+	while (have < 8) {
+		size_t n = read_some(buf + have, block_size + 8 - have);
+
+		if (n == 0) {
+			s.eof = true;
+			break;
+		}
+
+		have += n;
+	}
+
+	s.bytes = have & ~(size_t)7;
+	ncarry = have - s.bytes;
+	memcpy(carry, buf + s.bytes, ncarry);
+}
+
+void stream_reader::produce(void) {
+	unsigned idx = 0;
+
+	while (true) {
+		slot& s = slots[idx];
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			cond.wait(guard, [&] { return !s.full || stopping; });
+
+			if (stopping) {
+				return;
+			}
+		}
+
+		try {
+			fill(s);
+
+		} catch (...) {
+			std::lock_guard<std::mutex> guard(lock);
+			error = std::current_exception();
+			s.eof = true;
+			s.full = true;
+			cond.notify_all();
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			s.full = true;
+		}
+
+		cond.notify_all();
+
+		if (s.eof) {
+			return;
+		}
+
+		idx ^= 1;
+	}
+}
+
+uint32_t *stream_reader::next(size_t& entities) {
+	entities = 0;
+
+	if (done) {
+		return nullptr;
+	}
+
+	if (!read_ahead) {
+		slot& s = slots[0];
+		fill(s);
+		done = s.eof;
+		total += s.bytes;
+		entities = s.bytes / 8;
+		return (entities > 0)? s.buf.data() : nullptr;
+	}
+
+	// hand the last buffer back to the read-ahead thread
+	if (holding) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			slots[current].full = false;
+		}
+
+		cond.notify_all();
+		current ^= 1;
+		holding = false;
+	}
+
+	slot& s = slots[current];
+
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		cond.wait(guard, [&] { return s.full; });
+
+		if (error) {
+			done = true;
+			std::rethrow_exception(error);
+		}
+	}
+
+	holding = true;
+	done = s.eof;
+	total += s.bytes;
+	entities = s.bytes / 8;
+
+	return (entities > 0)? s.buf.data() : nullptr;
+}
+
+size_t stream_reader::feed(deserializer& der) {
+	size_t ret = 0;
+
+	while (!done) {
+		size_t n;
+		uint32_t *datas = next(n);
+
+		if (datas) {
+			der.deserialize(datas, n);
+			ret += n;
+		}
+	}
+
+	return ret;
+}
+
+// namespace anserial
+}
@@ -0,0 +1,242 @@
+#include <anserial/symbol_table.hpp>
+#include <anserial/binding.hpp>
+
+namespace anserial {
+
+symbol_table::symbol_table(const uint32_t *datas, size_t entities) {
+	load(datas, entities);
+}
+
+symbol_table::symbol_table(const uint32_t *datas, size_t entities, ent_order order) {
+	load(datas, entities, order);
+}
+
+symbol_table::symbol_table(s_node *symtab) {
+	load(symtab);
+}
+
+void symbol_table::clear(void) {
+	pool.clear();
+	slots.clear();
+	shift = 32;
+	count = 0;
+	clashes.clear();
+	mismatched.clear();
+}
+
+void symbol_table::load(const uint32_t *datas, size_t entities) {
+	load(datas, entities, detect_order(datas, entities));
+}
+
+void symbol_table::load(const uint32_t *datas, size_t entities, ent_order order) {
+	detail::raw_reader r = {datas, entities, order};
+	const uint32_t symtab_hash = hash_symbol("::symtab");
+	uint32_t symtab = entities;
+
+	clear();
+
+	if (entities == 0 || r.type(0) != ENT_TYPE_MAP) {
+		return;
+	}
+
+	// find ::symtab in the top-level map, later entries win
+	for (uint32_t j = 1; j < entities && r.parent(j) == 0;) {
+		uint32_t hash = r.data(j);
+		j = r.skip(j);
+
+		if (j >= entities || r.parent(j) != 0) {
+			break;
+		}
+
+		if (hash == symtab_hash) {
+			symtab = j;
+		}
+
+		j = r.skip(j);
+	}
+
+	while (symtab < entities && r.type(symtab) == ENT_TYPE_REF && r.data(symtab) < symtab) {
+		symtab = r.data(symtab);
+	}
+
+	if (symtab >= entities || r.type(symtab) != ENT_TYPE_MAP) {
+		return;
+	}
+
+	// symbol/string pairs, with the characters going straight into the
+	// pool. strings can be references when the serializer deduplicated
+	// them, in which case the characters are somewhere earlier.
+	for (uint32_t j = symtab + 1; j < entities && r.parent(j) == symtab;) {
+		uint32_t hash = r.data(j);
+		j = r.skip(j);
+
+		if (j >= entities || r.parent(j) != symtab) {
+			break;
+		}
+
+		uint32_t value = j;
+
+		while (r.type(value) == ENT_TYPE_REF && r.data(value) < value) {
+			value = r.data(value);
+		}
+
+		if (r.type(value) != ENT_TYPE_STRING) {
+			j = r.skip(j);
+			continue;
+		}
+
+		uint32_t offset = pool.size();
+		uint32_t k = value + 1;
+
+		for (; k < entities && r.parent(k) == value; k++) {
+			pool += (char)r.data(k);
+		}
+
+		commit(hash, offset);
+		j = (value == j)? k : r.skip(j);
+	}
+}
+
+void symbol_table::load(s_node *symtab) {
+	clear();
+
+	if (!symtab) {
+		return;
+	}
+
+	auto& keys = symtab->keys();
+	auto& values = symtab->entities();
+
+	// a key may be waiting on its value, if the map is still being parsed
+	for (size_t i = 0; i < keys.size() && i < values.size(); i++) {
+		std::string *name = values[i]->try_string();
+
+		if (name) {
+			add(keys[i]->self.data, *name);
+		}
+	}
+}
+
+void symbol_table::add(uint32_t hash, std::string_view name) {
+	uint32_t offset = pool.size();
+	pool.append(name.data(), name.size());
+	commit(hash, offset);
+}
+
+void symbol_table::commit(uint32_t hash, uint32_t offset) {
+	uint32_t length = pool.size() - offset;
+	std::string_view name(pool.data() + offset, length);
+
+	if (hash_symbol(name) != hash) {
+		mismatched.push_back(hash);
+	}
+
+	slot *s = const_cast<slot*>(probe(hash));
+
+	if (s) {
+		std::string_view old(pool.data() + s->offset, s->length);
+
+		if (old != name) {
+			clashes.push_back({hash, std::string(old), std::string(name)});
+		}
+
+		// the old name is left in the pool, there usually aren't any
+		s->offset = offset;
+		s->length = length;
+		return;
+	}
+
+	if (2*(count + 1) > slots.size()) {
+		grow();
+	}
+
+	size_t mask = slots.size() - 1;
+	size_t i = index(hash);
+
+	while (slots[i].length != EMPTY) {
+		i = (i + 1) & mask;
+	}
+
+	slots[i] = {hash, offset, length};
+	count++;
+}
+
+void symbol_table::grow(void) {
+	std::vector<slot> old;
+	old.swap(slots);
+
+	size_t size = old.empty()? 16 : 2*old.size();
+	slots.assign(size, {0, 0, EMPTY});
+
+	shift = 32;
+	for (size_t n = size; n > 1; n >>= 1) {
+		shift--;
+	}
+
+	size_t mask = size - 1;
+
+	for (const slot& s : old) {
+		if (s.length == EMPTY) {
+			continue;
+		}
+
+		size_t i = index(s.hash);
+
+		while (slots[i].length != EMPTY) {
+			i = (i + 1) & mask;
+		}
+
+		slots[i] = s;
+	}
+}
+
+void symbol_table::resolve(const uint32_t *hashes, size_t n, std::string_view *out) const {
+	// how far ahead to start loading slots, so that misses on big tables
+	// overlap rather than happening one after the other
+	const size_t ahead = 8;
+
+	if (slots.empty()) {
+		for (size_t i = 0; i < n; i++) {
+			out[i] = std::string_view();
+		}
+
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (i + ahead < n) {
+			__builtin_prefetch(&slots[index(hashes[i + ahead])]);
+		}
+
+		const slot *s = probe(hashes[i]);
+		out[i] = s? std::string_view(pool.data() + s->offset, s->length)
+		          : std::string_view();
+	}
+}
+
+void symbol_table::resolve(s_node *node, std::vector<std::string_view>& out) const {
+	out.clear();
+
+	if (!node) {
+		return;
+	}
+
+	auto& ents = (node->self.d_type == ENT_TYPE_MAP)? node->keys() : node->entities();
+	std::vector<uint32_t> hashes(ents.size());
+
+	for (size_t i = 0; i < ents.size(); i++) {
+		hashes[i] = ents[i]->self.data;
+	}
+
+	out.resize(ents.size());
+	resolve(hashes.data(), hashes.size(), out.data());
+
+	for (size_t i = 0; i < ents.size(); i++) {
+		if (ents[i]->self.d_type != ENT_TYPE_SYMBOL) {
+			out[i] = std::string_view();
+		}
+	}
+}
+
+// namespace anserial
+}
@@ -0,0 +1,257 @@
+#include <anserial/validate.hpp>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace anserial {
+
+// per-entity state for the structural pass, the low bits hold the type
+// (of the target, for references)
+enum {
+	STATE_TYPE      = 7,
+	STATE_REF       = 1 << 3,
+	// set when the next child of a map is a value rather than a key
+	STATE_MAP_VALUE = 1 << 4,
+	STATE_CHAR      = 1 << 5,
+};
+
+#if defined(__SSE2__)
+static inline __m128i bswap_epi32(__m128i x) {
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+#endif
+
+// first pass, checks that parents and reference targets come before each
+// entity and copies out the types. returns the first entity that fails.
+template <ent_order O>
+static size_t check_order(const uint32_t *datas, size_t entities, uint8_t *types) {
+	size_t i = 0;
+
+	if (entities > 0) {
+		uint32_t tag = load_word(datas[0], O);
+
+		// nothing comes before the top entity for it to refer to
+		if ((tag & ~(7 << 29)) != 0 || (tag >> 29) == ENT_TYPE_REF) {
+			return 0;
+		}
+
+		types[i++] = tag >> 29;
+	}
+
+#if defined(__SSE2__)
+	// unsigned compares are done as signed ones with the top bit flipped
+	const __m128i flip = _mm_set1_epi32(0x80000000);
+	const __m128i mask = _mm_set1_epi32(~(7 << 29));
+	const __m128i refs = _mm_set1_epi32(ENT_TYPE_REF);
+	const __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+
+	for (; i + 4 <= entities; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(datas + 2*i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(datas + 2*i + 4));
+
+		// [tag data tag data] x2 -> [tag tag tag tag], [data data data data]
+		a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+		b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+		__m128i tags = _mm_unpacklo_epi64(a, b);
+		__m128i data = _mm_unpackhi_epi64(a, b);
+
+		if (O == ORDER_NETWORK) {
+			tags = bswap_epi32(tags);
+			data = bswap_epi32(data);
+		}
+
+		__m128i ids = _mm_xor_si128(_mm_add_epi32(_mm_set1_epi32(i), lanes), flip);
+		__m128i parents = _mm_xor_si128(_mm_and_si128(tags, mask), flip);
+		__m128i type = _mm_srli_epi32(tags, 29);
+
+		__m128i ok = _mm_cmplt_epi32(parents, ids);
+		__m128i is_ref = _mm_cmpeq_epi32(type, refs);
+		__m128i ref_ok = _mm_cmplt_epi32(_mm_xor_si128(data, flip), ids);
+		ok = _mm_andnot_si128(_mm_andnot_si128(ref_ok, is_ref), ok);
+
+		if (_mm_movemask_ps(_mm_castsi128_ps(ok)) != 0xf) {
+			break;
+		}
+
+		__m128i packed = _mm_packs_epi32(type, type);
+		packed = _mm_packus_epi16(packed, packed);
+		uint32_t word = _mm_cvtsi128_si32(packed);
+		memcpy(types + i, &word, 4);
+	}
+#endif
+
+	for (; i < entities; i++) {
+		uint32_t tag = load_word(datas[2*i], O);
+		uint32_t data = load_word(datas[2*i + 1], O);
+
+		if ((tag & ~(7 << 29)) >= i || ((tag >> 29) == ENT_TYPE_REF && data >= i)) {
+			return i;
+		}
+
+		types[i] = tag >> 29;
+	}
+
+	return i;
+}
+
+// references have to come after everything under their target, or the
+// target could end up containing the reference, directly or by way of
+// other references. this finds the last entity under each one (0 for
+// none), going backwards so children are done before their parents.
+template <ent_order O>
+static validation check_targets(const uint32_t *datas, size_t entities,
+                                const uint8_t *st)
+{
+	validation ret;
+	std::vector<uint32_t> last(entities);
+
+	for (size_t i = entities; i-- > 1;) {
+		uint32_t parent = load_word(datas[2*i], O) & ~(7 << 29);
+		uint32_t end = (last[i] > i)? last[i] : i;
+		last[parent] = (last[parent] > end)? last[parent] : end;
+	}
+
+	for (size_t i = 1; i < entities; i++) {
+		if (!(st[i] & STATE_REF)) {
+			continue;
+		}
+
+		uint32_t target = load_word(datas[2*i + 1], O);
+
+		if (last[target] < i) {
+			continue;
+		}
+
+		// only for the error, see whether the target is an ancestor
+		uint32_t id = load_word(datas[2*i], O) & ~(7 << 29);
+
+		while (id > target) {
+			id = load_word(datas[2*id], O) & ~(7 << 29);
+		}
+
+		ret.entity = i;
+		ret.error = (id == target)
+			? "reference to its own ancestor"
+			: "reference to a subtree that grows after it";
+		return ret;
+	}
+
+	return ret;
+}
+
+template <ent_order O>
+static validation check_structure(const uint32_t *datas, size_t entities) {
+	validation ret;
+	std::vector<uint8_t> state(entities);
+	bool refs = false;
+
+	size_t end = check_order<O>(datas, entities, state.data());
+	uint8_t *st = state.data();
+
+	// everything before 'end' has valid parents and targets, so the rest
+	// can be checked with lookups into the state array
+	for (size_t i = 1; i < end; i++) {
+		uint32_t parent = load_word(datas[2*i], O) & ~(7 << 29);
+		uint8_t type = st[i];
+
+		if (type == ENT_TYPE_REF) {
+			uint32_t target = load_word(datas[2*i + 1], O);
+
+			if (st[target] & STATE_CHAR) {
+				ret.entity = i;
+				ret.error = "reference to a string character";
+				return ret;
+			}
+
+			type = st[target] & STATE_TYPE;
+			st[i] = type | STATE_REF;
+			refs = true;
+		}
+
+		uint8_t& ps = st[parent];
+		const char *error = nullptr;
+
+		if (ps & STATE_REF) {
+			error = "child of a reference";
+
+		} else switch (ps & STATE_TYPE) {
+			case ENT_TYPE_CONTAINER:
+				break;
+
+			case ENT_TYPE_MAP:
+				if (!(ps & STATE_MAP_VALUE) && type != ENT_TYPE_SYMBOL) {
+					error = "map key isn't a symbol";
+				}
+
+				ps ^= STATE_MAP_VALUE;
+				break;
+
+			case ENT_TYPE_SET:
+				if (type != ENT_TYPE_INTEGER && type != ENT_TYPE_SYMBOL) {
+					error = "set member isn't an integer or symbol";
+				}
+				break;
+
+			case ENT_TYPE_STRING:
+				if (type != ENT_TYPE_INTEGER) {
+					error = "string character isn't an integer";
+				}
+
+				st[i] |= STATE_CHAR;
+				break;
+
+			default:
+				error = "parent can't have children";
+				break;
+		}
+
+		if (error) {
+			ret.entity = i;
+			ret.error = error;
+			return ret;
+		}
+	}
+
+	if (end < entities) {
+		uint32_t parent = load_word(datas[2*end], O) & ~(7 << 29);
+
+		ret.entity = end;
+		ret.error = ((end == 0)? parent != 0 : parent >= end)
+			? "parent doesn't come first"
+			: "reference doesn't point back";
+		return ret;
+	}
+
+	for (size_t i = 0; i < entities; i++) {
+		if ((st[i] & (STATE_TYPE | STATE_REF | STATE_MAP_VALUE))
+		    == (ENT_TYPE_MAP | STATE_MAP_VALUE))
+		{
+			ret.entity = i;
+			ret.error = "map key without a value";
+			return ret;
+		}
+	}
+
+	return refs? check_targets<O>(datas, entities, st) : ret;
+}
+
+validation validate(const uint32_t *datas, size_t entities) {
+	return validate(datas, entities, detect_order(datas, entities));
+}
+
+validation validate(const uint32_t *datas, size_t entities, ent_order order) {
+	return (order == ORDER_NATIVE)
+		? check_structure<ORDER_NATIVE>(datas, entities)
+		: check_structure<ORDER_NETWORK>(datas, entities);
+}
+
+validation validate(const std::vector<uint32_t>& datas) {
+	return validate(datas.data(), datas.size() / 2);
+}
+
+// namespace anserial
+}
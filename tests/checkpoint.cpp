@@ -0,0 +1,181 @@
+// checks that an ingest stopped at any entity, checkpointed and restored
+// into a new deserializer, finishes with the same tree and the same events
+// as one that ran straight through
+#include <anserial/anserial.hpp>
+#include <stdexcept>
+#include <stdio.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+class recorder : public deserializer_events {
+	public:
+		std::vector<std::string> log;
+
+		void add(const char *what, uint32_t parent, uint32_t id, uint32_t data = 0) {
+			log.push_back(std::string(what) + " " + std::to_string(parent) + " "
+			              + std::to_string(id) + " " + std::to_string(data));
+		}
+
+		void on_container(uint32_t p, uint32_t id) override { add("container", p, id); }
+		void on_map(uint32_t p, uint32_t id) override { add("map", p, id); }
+		void on_set(uint32_t p, uint32_t id) override { add("set", p, id); }
+		void on_null(uint32_t p, uint32_t id) override { add("null", p, id); }
+		void on_map_key(uint32_t p, uint32_t id, uint32_t s) override { add("key", p, id, s); }
+		void on_symbol(uint32_t p, uint32_t id, uint32_t s) override { add("symbol", p, id, s); }
+		void on_integer(uint32_t p, uint32_t id, uint32_t v) override { add("integer", p, id, v); }
+		void on_ref(uint32_t p, uint32_t id, uint32_t t) override { add("ref", p, id, t); }
+
+		void on_string_complete(uint32_t p, uint32_t id, const std::string& str) override {
+			add("string", p, id);
+			log.back() += " " + str;
+		}
+};
+
+static std::vector<uint32_t> gen_records(ent_order order) {
+	serializer ser;
+	ser.order = order;
+	ser.dedup = true;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	for (uint32_t i = 0; i < 12; i++) {
+		ser.add_entities(cont,
+			{"record",
+				{"id", i % 4},
+				{"name", (i % 3)? "abc" : "defghi"}});
+
+		uint32_t map = ser.add_map(cont);
+		ser.add_symbol(map, "tags");
+		ser.add_string(map, "tag" + std::to_string(i % 2));
+		ser.add_symbol(map, "empty");
+		ser.add_set(map);
+	}
+
+	ser.add_symtab(0);
+	return ser.serialize();
+}
+
+enum mode { NODES, NODES_AND_EVENTS, EVENTS };
+
+static void setup(deserializer& der, recorder& rec, mode m) {
+	der.events = (m == NODES)? nullptr : &rec;
+	der.build_nodes = (m != EVENTS);
+}
+
+static void clean_up(deserializer& der) {
+	if (der.build_nodes) {
+		delete der.deserialize();
+	}
+}
+
+int main(void) {
+	for (ent_order order : {ORDER_NETWORK, ORDER_NATIVE}) {
+		auto buf = gen_records(order);
+		size_t n = buf.size() / 2;
+
+		for (mode m : {NODES, NODES_AND_EVENTS, EVENTS}) {
+			recorder full_rec;
+			deserializer full;
+			setup(full, full_rec, m);
+			full.deserialize(buf.data(), n);
+			full.finish();
+			auto want = full.checkpoint(n);
+
+			// stopping at every entity catches map keys waiting on
+			// their values and strings partway through their characters
+			for (size_t cut = 0; cut <= n; cut++) {
+				recorder rec;
+				deserializer first;
+				setup(first, rec, m);
+				first.deserialize(buf.data(), cut);
+				auto saved = first.checkpoint(cut);
+				clean_up(first);
+
+				deserializer second;
+				setup(second, rec, m);
+				CHECK(second.restore(saved) == cut);
+				CHECK(second.ent_counter == cut);
+				CHECK(cut == 0 || second.order == order);
+
+				second.deserialize(buf.data() + 2*cut, n - cut);
+				second.finish();
+
+				CHECK(rec.log == full_rec.log);
+				CHECK(second.checkpoint(n) == want);
+
+				if (failures) {
+					fprintf(stderr, "order %d, mode %d, cut at %zu of %zu\n",
+					        order, m, cut, n);
+					return 1;
+				}
+
+				clean_up(second);
+			}
+
+			clean_up(full);
+		}
+	}
+
+	auto buf = gen_records(ORDER_NETWORK);
+	recorder rec;
+	deserializer der(buf);
+	auto saved = der.checkpoint(42);
+	delete der.deserialize();
+
+	// only into an empty deserializer
+	{
+		deserializer x(buf.data(), 4);
+		bool threw = false;
+
+		try {
+			x.restore(saved);
+		} catch (const std::logic_error&) {
+			threw = true;
+		}
+
+		CHECK(threw);
+		delete x.deserialize();
+	}
+
+	// nodes and events have to be set up the same way
+	{
+		deserializer x;
+		setup(x, rec, EVENTS);
+		bool threw = false;
+
+		try {
+			x.restore(saved);
+		} catch (const std::logic_error&) {
+			threw = true;
+		}
+
+		CHECK(threw && x.ent_counter == 0);
+	}
+
+	// not a checkpoint, or the end cut off
+	for (size_t len : {(size_t)0, (size_t)16, saved.size() - 1}) {
+		deserializer x;
+		bool threw = false;
+
+		try {
+			x.restore(saved.data(), len);
+		} catch (const std::exception&) {
+			threw = true;
+		}
+
+		CHECK(threw);
+		clean_up(x);
+	}
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,105 @@
+// checks compact_tree navigation against what was serialized, and that
+// malformed parents and references are rejected
+#include <anserial/anserial.hpp>
+#include <anserial/compact_tree.hpp>
+#include <stdexcept>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct ent { uint32_t type, parent, data; };
+
+// written as-is in network order, the serializer won't write these
+static std::vector<uint32_t> build(std::initializer_list<ent> ents) {
+	std::vector<uint32_t> ret;
+
+	for (const ent& e : ents) {
+		ret.push_back(htonl(e.type << 29 | e.parent));
+		ret.push_back(htonl(e.data));
+	}
+
+	return ret;
+}
+
+static bool rejected(const std::vector<uint32_t>& buf) {
+	try {
+		compact_tree tree(buf);
+	} catch (const std::out_of_range&) {
+		return true;
+	}
+
+	return false;
+}
+
+int main(void) {
+	{
+		serializer ser;
+		uint32_t top = ser.default_layout();
+		uint32_t cont = ser.add_container(top);
+
+		for (uint32_t i = 0; i < 100; i++) {
+			uint32_t map = ser.add_map(cont);
+			ser.add_symbol(map, "id");
+			ser.add_integer(map, i);
+			ser.add_symbol(map, "name");
+			ser.add_string(map, "n" + std::to_string(i));
+		}
+
+		ser.add_symtab(top);
+
+		compact_tree tree(ser.serialize());
+		uint32_t list = tree.get(tree.data(), 0);
+		uint32_t value;
+
+		CHECK(tree.count(list) == 100);
+
+		for (uint32_t i = 0; i < tree.count(list); i++) {
+			uint32_t rec = tree.get(list, i);
+
+			CHECK(tree.uint(tree.get(rec, "id"), value) && value == i);
+			CHECK(tree.string(tree.get(rec, "name")) == "n" + std::to_string(i));
+		}
+
+		CHECK(tree.get(tree.get(list, 0), "missing") == compact_tree::npos);
+	}
+
+	// only the top entity is its own parent
+	CHECK(rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_CONTAINER, 1, 0},
+	})));
+
+	CHECK(rejected(build({
+		{ENT_TYPE_CONTAINER, 1, 0},
+		{ENT_TYPE_CONTAINER, 0, 0},
+	})));
+
+	CHECK(rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_INTEGER,   2, 0},
+	})));
+
+	CHECK(rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_REF,       0, 1},
+	})));
+
+	CHECK(!rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_REF,       0, 1},
+	})));
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,103 @@
+// checks that compressed blocks round trip, and that the reader refuses
+// block headers claiming more entities than it was asked to allow or than
+// the payload could hold
+#include <anserial/anserial.hpp>
+#include <anserial/compress.hpp>
+#include <stdexcept>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::vector<uint32_t> gen_records(unsigned records) {
+	serializer ser;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	for (uint32_t i = 0; i < records; i++) {
+		ser.add_entities(cont, {"record", {"id", i}, {"name", "abc"}});
+	}
+
+	ser.add_symtab(top);
+	return ser.serialize();
+}
+
+template <typename E, typename F>
+static bool throws(F fn) {
+	try {
+		fn();
+	} catch (const E&) {
+		return true;
+	}
+
+	return false;
+}
+
+int main(void) {
+	auto buf = gen_records(2000);
+	size_t entities = buf.size() / 2;
+	auto z = compress_entities(buf, 1000);
+
+	// more threads than blocks, and fewer
+	for (unsigned threads : {1, 3, 64}) {
+		compressed_reader reader(z.data(), z.size());
+		CHECK(reader.entities() == entities);
+		CHECK(reader.decompress(threads) == buf);
+	}
+
+	// a limit at the size fits, one below it doesn't
+	CHECK(compressed_reader(z.data(), z.size(), entities).entities() == entities);
+	CHECK(throws<std::length_error>([&] {
+		compressed_reader(z.data(), z.size(), entities - 1);
+	}));
+
+	// and the deserializer's limits are checked before decompressing
+	{
+		deserializer der;
+		der.limits.max_entities = entities - 1;
+		CHECK(throws<std::length_error>([&] {
+			der.deserialize_compressed(z.data(), z.size());
+		}));
+		CHECK(der.ent_counter == 0);
+	}
+
+	{
+		deserializer der;
+		der.limits.max_bytes = 8*entities - 1;
+		CHECK(throws<std::length_error>([&] {
+			der.deserialize_compressed(z.data(), z.size());
+		}));
+		CHECK(der.ent_counter == 0);
+	}
+
+	{
+		deserializer der;
+		der.limits.max_entities = entities;
+		delete der.deserialize_compressed(z.data(), z.size());
+		CHECK(der.ent_counter == entities);
+	}
+
+	// a block claiming far more entities than its payload could ever
+	// decompress to
+	{
+		auto bad = z;
+		uint32_t *header = (uint32_t*)bad.data();
+		header[2] = htonl(0x10000000);
+
+		CHECK(throws<std::invalid_argument>([&] {
+			compressed_reader(bad.data(), bad.size());
+		}));
+	}
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,128 @@
+// checks which entities get nodes, and that the deserializer's limits are
+// enforced
+#include <anserial/anserial.hpp>
+#include <stdexcept>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct ent { uint32_t type, parent, data; };
+
+// written as-is in network order, the serializer won't write some of these
+static std::vector<uint32_t> build(std::initializer_list<ent> ents) {
+	std::vector<uint32_t> ret;
+
+	for (const ent& e : ents) {
+		ret.push_back(htonl(e.type << 29 | e.parent));
+		ret.push_back(htonl(e.data));
+	}
+
+	return ret;
+}
+
+template <typename E, typename F>
+static bool throws(F fn) {
+	try {
+		fn();
+	} catch (const E&) {
+		return true;
+	}
+
+	return false;
+}
+
+int main(void) {
+	// characters have no nodes, their string and everything else does
+	{
+		serializer ser;
+		uint32_t top = ser.add_container(0);
+		uint32_t str = ser.add_string(top, "abc");
+		uint32_t num = ser.add_integer(top, 5);
+		auto buf = ser.serialize();
+
+		deserializer der(buf);
+		CHECK(der.nodes.size() == der.ent_counter);
+		CHECK(der.nodes[top] && der.nodes[str] && der.nodes[num]);
+		CHECK(der.nodes[str]->string() == "abc");
+		CHECK(der.nodes[num]->uint() == 5);
+
+		for (uint32_t i = str + 1; i < num; i++) {
+			CHECK(der.nodes[i] == nullptr);
+		}
+
+		delete der.deserialize();
+	}
+
+	// nor does anything under a character, and nothing can refer to one
+	{
+		auto buf = build({
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_STRING,    0, 0},
+			{ENT_TYPE_INTEGER,   1, 'a'},
+			{ENT_TYPE_INTEGER,   2, 'b'},
+		});
+
+		deserializer der(buf);
+		CHECK(der.ent_counter == 4);
+		CHECK(der.nodes[2] == nullptr && der.nodes[3] == nullptr);
+		CHECK(der.nodes[1]->string() == "a");
+		delete der.deserialize();
+
+		buf = build({
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_STRING,    0, 0},
+			{ENT_TYPE_INTEGER,   1, 'a'},
+			{ENT_TYPE_REF,       0, 2},
+		});
+
+		deserializer x;
+		CHECK(throws<std::out_of_range>([&] { x.deserialize(buf); }));
+		delete x.deserialize();
+	}
+
+	// limits throw as soon as they're crossed
+	{
+		serializer ser;
+		uint32_t cur = ser.add_container(0);
+
+		for (unsigned i = 0; i < 100; i++) {
+			cur = ser.add_container(cur);
+		}
+
+		auto buf = ser.serialize();
+
+		deserializer a;
+		a.limits.max_entities = 50;
+		CHECK(throws<std::length_error>([&] { a.deserialize(buf); }));
+		CHECK(a.ent_counter == 50);
+		delete a.deserialize();
+
+		deserializer b;
+		b.limits.max_depth = 10;
+		CHECK(throws<std::length_error>([&] { b.deserialize(buf); }));
+		delete b.deserialize();
+
+		deserializer c;
+		c.limits.max_bytes = 1024;
+		CHECK(throws<std::length_error>([&] { c.deserialize(buf); }));
+		delete c.deserialize();
+
+		deserializer d(buf);
+		CHECK(d.ent_counter == 101);
+		CHECK(d.bytes_allocated > 0 && d.peak_bytes >= d.bytes_allocated);
+		delete d.deserialize();
+	}
+
+	return failures? 1 : 0;
+}
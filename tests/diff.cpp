@@ -0,0 +1,103 @@
+// checks that applying a patch gives back its target exactly, with records
+// changed, inserted and removed, and across byte orders
+#include <anserial/anserial.hpp>
+#include <stdio.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+// a list of records, with 'edit' out of every 1000 of them changed, the
+// same number removed and the same number inserted. 0 gives the base.
+static std::vector<uint32_t> gen_records(unsigned records, unsigned edit,
+                                         ent_order order)
+{
+	serializer ser;
+	ser.order = order;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+	uint32_t state = 2048;
+
+	auto next = [&] {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	};
+
+	for (unsigned i = 0; i < records; i++) {
+		unsigned roll = next() % 1000;
+		uint32_t value = i;
+
+		if (roll < edit) {
+			continue;
+
+		} else if (roll < 2*edit) {
+			ser.add_entities(cont, {"inserted", {"value", next()}, "extra"});
+
+		} else if (roll < 3*edit) {
+			value = next();
+		}
+
+		ser.add_entities(cont,
+			{"record",
+				{"id", i},
+				{"value", value*19937},
+				"name"});
+	}
+
+	ser.add_symtab(top);
+	return ser.serialize();
+}
+
+static void check_round_trip(const std::vector<uint32_t>& base,
+                             const std::vector<uint32_t>& target)
+{
+	std::vector<uint32_t> patch = make_patch(base, target);
+	CHECK(apply_patch(base, patch) == target);
+}
+
+int main(void) {
+	const ent_order orders[] = { ORDER_NETWORK, ORDER_NATIVE };
+
+	for (ent_order base_order : orders) {
+		for (ent_order target_order : orders) {
+			std::vector<uint32_t> base = gen_records(2000, 0, base_order);
+
+			for (unsigned edit : {0, 1, 10, 100, 333}) {
+				check_round_trip(base, gen_records(2000, edit, target_order));
+			}
+
+			// everything or nothing in common
+			check_round_trip(base, gen_records(10, 0, target_order));
+			check_round_trip(gen_records(10, 0, base_order), base);
+		}
+	}
+
+	// small edits should give small patches
+	std::vector<uint32_t> base = gen_records(2000, 0, ORDER_NETWORK);
+	std::vector<uint32_t> target = gen_records(2000, 1, ORDER_NETWORK);
+	CHECK(make_patch(base, target).size() < target.size() / 10);
+
+	// patches only apply to the base they were made against
+	std::vector<uint32_t> patch = make_patch(base, target);
+	bool threw = false;
+
+	try {
+		apply_patch(target, patch);
+	} catch (const std::invalid_argument&) {
+		threw = true;
+	}
+
+	CHECK(threw);
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,218 @@
+// checks that frames sent in batches over a socket come back out whole and
+// in order, however the stream is split up, and that bad or oversized
+// headers and truncated input are refused
+#include <anserial/anserial.hpp>
+#include <anserial/framing.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::vector<uint32_t> gen_record(uint32_t n) {
+	serializer ser;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	// records grow, so later frames outgrow a small reader buffer
+	for (uint32_t i = 0; i <= n; i++) {
+		ser.add_entities(cont, {"record", {"id", i}, {"name", "abc"}});
+	}
+
+	return ser.serialize();
+}
+
+// bytes to send for each case, written by a child process in odd sized
+// pieces so frames and headers are split across reads
+static int spawn_writer(const std::vector<uint8_t>& bytes, pid_t& pid) {
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+		perror("socketpair");
+		exit(1);
+	}
+
+	pid = fork();
+
+	if (pid == 0) {
+		close(fds[0]);
+
+		for (size_t pos = 0, step = 1; pos < bytes.size(); pos += step, step = step % 11 + 1) {
+			size_t n = (bytes.size() - pos < step)? bytes.size() - pos : step;
+			(void)!write(fds[1], bytes.data() + pos, n);
+		}
+
+		_exit(0);
+	}
+
+	close(fds[1]);
+	return fds[0];
+}
+
+static std::vector<uint8_t> header(uint32_t word, uint32_t entities) {
+	uint32_t h[2] = {htonl(word), htonl(entities)};
+	return std::vector<uint8_t>((uint8_t*)h, (uint8_t*)h + FRAME_HEADER);
+}
+
+// reads frames until the reader throws E, returns the number read first
+template <typename E>
+static int frames_before(const std::vector<uint8_t>& bytes, size_t max_entities = 1 << 24) {
+	pid_t pid;
+	int fd = spawn_writer(bytes, pid);
+	frame_reader r(fd, 64);
+	r.max_entities = max_entities;
+	frame_reader::frame f;
+	int n = 0;
+
+	try {
+		while (r.next(f)) {
+			n++;
+		}
+
+		n = -1;
+	} catch (const E&) {
+	}
+
+	close(fd);
+	waitpid(pid, nullptr, 0);
+	return n;
+}
+
+static void on_alarm(int) {
+	static const char msg[] = "framing test timed out\n";
+	(void)!write(2, msg, sizeof(msg) - 1);
+	_exit(1);
+}
+
+int main(void) {
+	signal(SIGALRM, on_alarm);
+	alarm(30);
+
+	std::vector<std::vector<uint32_t>> records;
+
+	for (uint32_t i = 0; i < 50; i++) {
+		records.push_back(gen_record(i));
+	}
+
+	// one batch through a frame_writer, with an empty frame in the middle
+	{
+		int fds[2];
+		CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			close(fds[0]);
+			frame_writer w(fds[1]);
+
+			for (size_t i = 0; i < records.size(); i++) {
+				w.queue(records[i].data(), records[i].size() / 2, i);
+
+				if (i == 25) {
+					w.queue(nullptr, 0, 0xffff);
+				}
+			}
+
+			w.flush();
+			_exit(w.pending() == 0? 0 : 1);
+		}
+
+		close(fds[1]);
+
+		frame_reader r(fds[0], 64);
+		frame_reader::frame f;
+		size_t i = 0;
+
+		while (r.next(f)) {
+			if (i == 26) {
+				CHECK(f.type == 0xffff && f.entities == 0);
+				i++;
+				continue;
+			}
+
+			size_t k = (i > 26)? i - 1 : i;
+			CHECK(k < records.size());
+
+			if (k < records.size()) {
+				CHECK(f.type == k);
+				CHECK(f.entities*2 == records[k].size());
+				CHECK(std::equal(f.datas, f.datas + 2*f.entities, records[k].begin()));
+
+				// frames deserialize in place
+				deserializer der(f.datas, f.entities);
+				s_node *root = der.deserialize();
+				CHECK(root->get("::data")->get(0)->entities().size() == k + 1);
+				delete root;
+			}
+
+			i++;
+		}
+
+		CHECK(i == records.size() + 1);
+
+		int status;
+		waitpid(pid, &status, 0);
+		CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		close(fds[0]);
+	}
+
+	// the same frames written a few bytes at a time
+	std::vector<uint8_t> stream;
+
+	for (size_t i = 0; i < 10; i++) {
+		auto h = header(FRAME_MAGIC << 16 | i, records[i].size() / 2);
+		stream.insert(stream.end(), h.begin(), h.end());
+		stream.insert(stream.end(), (uint8_t*)records[i].data(),
+		              (uint8_t*)(records[i].data() + records[i].size()));
+	}
+
+	CHECK(frames_before<std::runtime_error>(stream) == -1);
+
+	// a header claiming more than max_entities is refused before anything
+	// is allocated for it
+	{
+		auto bytes = stream;
+		auto h = header(FRAME_MAGIC << 16, 0x7fffffff);
+		bytes.insert(bytes.end(), h.begin(), h.end());
+		CHECK(frames_before<std::length_error>(bytes) == 10);
+
+		size_t largest = records[9].size() / 2;
+		CHECK(frames_before<std::length_error>(stream, largest - 1) == 9);
+		CHECK(frames_before<std::length_error>(stream, largest) == -1);
+	}
+
+	// bad magic, and input ending partway through a header or a frame
+	{
+		auto bytes = stream;
+		auto h = header(0x1234 << 16, 1);
+		bytes.insert(bytes.end(), h.begin(), h.end());
+		CHECK(frames_before<std::runtime_error>(bytes) == 10);
+
+		bytes = stream;
+		bytes.resize(bytes.size() - 3);
+		CHECK(frames_before<std::runtime_error>(bytes) == 9);
+
+		bytes = stream;
+		h = header(FRAME_MAGIC << 16, 1);
+		bytes.insert(bytes.end(), h.begin(), h.begin() + 5);
+		CHECK(frames_before<std::runtime_error>(bytes) == 10);
+	}
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,124 @@
+// checks that live_tree snapshots don't change as entities are added, with
+// a reader thread taking snapshots during ingest, and that bad parents are
+// rejected after publishing everything before them
+#include <anserial/anserial.hpp>
+#include <anserial/live_tree.hpp>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+using namespace anserial;
+
+static std::atomic<unsigned> failures{0};
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::vector<uint32_t> gen_records(unsigned records) {
+	serializer ser;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	for (uint32_t i = 0; i < records; i++) {
+		ser.add_entities(cont, {"record", {"id", i}});
+	}
+
+	return ser.serialize();
+}
+
+// records visible in a snapshot, checking each one it can see whole
+static uint32_t count_records(const live_snapshot& snap) {
+	uint32_t list = snap.get(snap.data(), 0);
+	uint32_t ret = 0;
+
+	for (uint32_t rec = snap.first_child(list); rec != live_snapshot::npos;
+	     rec = snap.next_sibling(rec))
+	{
+		uint32_t pair = snap.get(rec, 1);
+		uint32_t value;
+
+		if (pair != live_snapshot::npos && snap.uint(snap.get(pair, 1), value)) {
+			CHECK(value == ret);
+		}
+
+		ret++;
+	}
+
+	return ret;
+}
+
+int main(void) {
+	auto buf = gen_records(5000);
+	size_t entities = buf.size() / 2;
+
+	{
+		live_tree tree;
+		std::atomic<bool> writing{true};
+
+		std::thread reader([&] {
+			uint32_t last = 0;
+
+			while (writing) {
+				live_snapshot snap = tree.snapshot();
+				uint32_t n = snap.size()? count_records(snap) : 0;
+
+				CHECK(n >= last);
+				CHECK(n == count_records(snap));
+				last = n;
+			}
+		});
+
+		live_snapshot before;
+
+		for (size_t pos = 0; pos < entities; pos += 97) {
+			size_t n = (entities - pos < 97)? entities - pos : 97;
+			tree.deserialize(buf.data() + 2*pos, n);
+
+			if (pos == 97*20) {
+				before = tree.snapshot();
+			}
+		}
+
+		writing = false;
+		reader.join();
+
+		// an old snapshot stays as it was
+		uint32_t old_records = count_records(before);
+		CHECK(before.size() == 97*21);
+		CHECK(old_records < 5000);
+		CHECK(count_records(before) == old_records);
+		CHECK(count_records(tree.snapshot()) == 5000);
+		CHECK(tree.size() == entities);
+	}
+
+	// an entity that's its own parent, after two good ones
+	{
+		std::vector<uint32_t> bad = {
+			htonl(ENT_TYPE_CONTAINER << 29 | 0), 0,
+			htonl(ENT_TYPE_CONTAINER << 29 | 0), 0,
+			htonl(ENT_TYPE_INTEGER << 29 | 2), 0,
+		};
+
+		live_tree tree;
+		bool threw = false;
+
+		try {
+			tree.deserialize(bad);
+		} catch (const std::out_of_range&) {
+			threw = true;
+		}
+
+		CHECK(threw);
+		CHECK(tree.size() == 2);
+		CHECK(tree.snapshot().size() == 2);
+	}
+
+	return failures? 1 : 0;
+}
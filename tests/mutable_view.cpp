@@ -0,0 +1,123 @@
+// checks that mutable_view writes land on the right entity and nowhere
+// else, in both byte orders, and that rejected writes change nothing
+#include <anserial/anserial.hpp>
+#include <anserial/binding.hpp>
+#include <anserial/mutable_view.hpp>
+#include <stdexcept>
+#include <stdio.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct record {
+	uint32_t id;
+	uint32_t count;
+};
+
+ANSERIAL_BINDING(record,
+	ANSERIAL_FIELD(id),
+	ANSERIAL_FIELD(count));
+
+static std::vector<uint32_t> gen_records(unsigned records, ent_order order,
+                                         bool dedup = false)
+{
+	serializer ser;
+	ser.order = order;
+	ser.dedup = dedup;
+	uint32_t data = ser.default_layout();
+
+	for (uint32_t i = 0; i < records; i++) {
+		if (dedup) {
+			ser.add_entities(data, {{"id", i % 4}, {"count", 10*(i % 4)}});
+			continue;
+		}
+
+		uint32_t map = ser.add_map(data);
+		ser.add_symbol(map, "id");
+		ser.add_integer(map, i);
+		ser.add_symbol(map, "count");
+		ser.add_integer(map, 10*i);
+	}
+
+	ser.add_symtab(0);
+	return ser.serialize();
+}
+
+template <typename E, typename F>
+static bool throws(F fn) {
+	try {
+		fn();
+	} catch (const E&) {
+		return true;
+	}
+
+	return false;
+}
+
+int main(void) {
+	for (ent_order order : {ORDER_NETWORK, ORDER_NATIVE}) {
+		for (bool indexed : {false, true}) {
+			auto buf = gen_records(100, order);
+			auto orig = buf;
+			mutable_view v(buf.data(), buf.size() / 2);
+
+			if (indexed) {
+				v.index_children();
+			}
+
+			uint32_t rec = v.resolve({"::data", 42u});
+			uint32_t count = v.resolve({"count"}, rec);
+			CHECK(v.data(count) == 420);
+
+			v.set_uint(count, 12345);
+
+			// only the data word of that entity changed, and readers see it
+			for (size_t i = 0; i < buf.size(); i++) {
+				CHECK(buf[i] == orig[i] || i == 2*count + 1);
+			}
+
+			record r;
+			CHECK(decode(buf, rec, r));
+			CHECK(r.id == 42 && r.count == 12345);
+
+			// batches are checked up front, so a bad one writes nothing
+			uint32_t other = v.resolve({"::data", 7u, "count"});
+			orig = buf;
+
+			CHECK(throws<std::logic_error>([&] {
+				v.apply({{other, 1}, {rec, 2}});
+			}));
+			CHECK(buf == orig);
+
+			v.apply({{other, 1}, {count, 2}});
+			CHECK(v.data(other) == 1 && v.data(count) == 2);
+
+			// only integers can be written
+			CHECK(throws<std::logic_error>([&] { v.set_uint(rec, 0); }));
+			CHECK(throws<std::out_of_range>([&] { v.set_uint(buf.size(), 0); }));
+			CHECK(throws<std::out_of_range>([&] { v.resolve({"::data", 100u}); }));
+			CHECK(throws<std::out_of_range>([&] { v.resolve({"::data", 0u, "missing"}); }));
+		}
+	}
+
+	// paths through a deduplicated copy would change every copy
+	{
+		auto buf = gen_records(8, ORDER_NETWORK, true);
+		mutable_view v(buf.data(), buf.size() / 2);
+
+		// records are [[id, n], [count, n*10]]
+		CHECK(v.data(v.resolve({"::data", 1u, 0u, 1u})) == 1);
+		CHECK(throws<std::logic_error>([&] { v.resolve({"::data", 5u, 0u, 1u}); }));
+	}
+
+	return failures? 1 : 0;
+}
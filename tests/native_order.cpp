@@ -0,0 +1,144 @@
+// round-trips every top-level entity type through native byte order, and
+// checks that the order is detected the same way it was written
+#include <anserial/anserial.hpp>
+#include <stdio.h>
+#include <typeinfo>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+// writes a top entity of the given type with a few children, if it can have any
+static std::vector<uint32_t> write_root(uint32_t type, ent_order order) {
+	serializer ser;
+	ser.order = order;
+
+	switch (type) {
+		case ENT_TYPE_CONTAINER:
+			{
+				uint32_t top = ser.add_container(0);
+				ser.add_integer(top, 1);
+				ser.add_string(top, "foo");
+				ser.add_container(top);
+			}
+			break;
+
+		case ENT_TYPE_MAP:
+			{
+				uint32_t top = ser.add_map(0);
+				ser.add_symbol(top, "a");
+				ser.add_integer(top, 2);
+				ser.add_symbol(top, "b");
+				ser.add_string(top, "bar");
+			}
+			break;
+
+		case ENT_TYPE_SET:
+			{
+				uint32_t top = ser.add_set(0);
+				ser.add_integer(top, 42);
+				ser.add_symbol(top, "c");
+			}
+			break;
+
+		case ENT_TYPE_STRING:  ser.add_string(0, "baz"); break;
+		case ENT_TYPE_NULL:    ser.add_null(0); break;
+		case ENT_TYPE_INTEGER: ser.add_integer(0, 3); break;
+		case ENT_TYPE_SYMBOL:  ser.add_symbol(0, "d"); break;
+	}
+
+	return ser.serialize();
+}
+
+// everything but the data word of the top entity, which holds the mark
+static bool same_nodes(const deserializer& a, const deserializer& b) {
+	if (a.ent_counter != b.ent_counter) {
+		return false;
+	}
+
+	for (uint32_t i = 0; i < a.ent_counter; i++) {
+		s_node *x = a.nodes[i];
+		s_node *y = b.nodes[i];
+
+		if (!x || !y) {
+			if (x != y) return false;
+			continue;
+		}
+
+		if (typeid(*x) != typeid(*y)
+		    || x->self.d_type != y->self.d_type
+		    || x->self.parent != y->self.parent
+		    || (i > 0 && x->self.data != y->self.data)
+		    || x->entities().size() != y->entities().size())
+		{
+			return false;
+		}
+
+		if (typeid(*x) == typeid(s_string) && x->string() != y->string()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(void) {
+	const uint32_t marked[] = {
+		ENT_TYPE_CONTAINER, ENT_TYPE_STRING, ENT_TYPE_MAP,
+		ENT_TYPE_SET, ENT_TYPE_NULL,
+	};
+
+	for (uint32_t type : marked) {
+		std::vector<uint32_t> native = write_root(type, ORDER_NATIVE);
+		std::vector<uint32_t> network = write_root(type, ORDER_NETWORK);
+
+		CHECK(detect_order(native.data(), native.size() / 2) == ORDER_NATIVE);
+		CHECK(detect_order(network.data(), network.size() / 2) == ORDER_NETWORK);
+
+		deserializer a, b;
+		a.deserialize(native);
+		b.deserialize(network);
+
+		CHECK(a.order == ORDER_NATIVE);
+		CHECK(b.order == ORDER_NETWORK);
+		CHECK(a.nodes[0]->self.d_type == type);
+		CHECK(same_nodes(a, b));
+
+		if (type == ENT_TYPE_SET) {
+			CHECK(a.nodes[0]->contains(42));
+		}
+	}
+
+	// these need their data word, so there's nowhere to put a mark
+	const uint32_t unmarked[] = { ENT_TYPE_INTEGER, ENT_TYPE_SYMBOL };
+
+	for (uint32_t type : unmarked) {
+		bool threw = false;
+
+		try {
+			write_root(type, ORDER_NATIVE);
+		} catch (const std::invalid_argument&) {
+			threw = true;
+		}
+
+		CHECK(threw);
+
+		std::vector<uint32_t> network = write_root(type, ORDER_NETWORK);
+		CHECK(detect_order(network.data(), network.size() / 2) == ORDER_NETWORK);
+	}
+
+	// a network order integer that looks like the mark when read natively
+	serializer ser;
+	ser.add_integer(0, ntohl(ORDER_MARK));
+	CHECK(detect_order(ser.output.data(), 1) == ORDER_NETWORK);
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,165 @@
+// checks that record logs read back what was written, that writers recover
+// from a stale index and a torn last record, and that compaction keeps the
+// right records and locks out writers
+#include <anserial/anserial.hpp>
+#include <anserial/record_log.hpp>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::vector<uint32_t> gen_record(uint32_t n) {
+	serializer ser;
+	uint32_t top = ser.default_layout();
+	ser.add_entities(top, {"record", {"id", n}, {"name", "abc"}});
+	return ser.serialize();
+}
+
+// record n of the log should be gen_record(first + n), at 10 times that
+static void check_records(const std::string& path, uint32_t first, size_t count) {
+	record_log log(path);
+	CHECK(log.size() == count);
+
+	for (size_t i = 0; i < log.size(); i++) {
+		auto expected = gen_record(first + i);
+		record_log::record r = log.get(i);
+
+		CHECK(r.timestamp == 10*(first + i));
+		CHECK(r.entities*2 == expected.size()
+		      && memcmp(r.datas, expected.data(), expected.size()*4) == 0);
+	}
+}
+
+static off_t file_size(const std::string& path) {
+	struct stat st;
+	return (stat(path.c_str(), &st) == 0)? st.st_size : -1;
+}
+
+static bool throws_runtime_error(void (*fn)(const std::string&), const std::string& path) {
+	try {
+		fn(path);
+	} catch (const std::runtime_error&) {
+		return true;
+	}
+
+	return false;
+}
+
+int main(void) {
+	char dir[] = "/tmp/anserial-test-XXXXXX";
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	std::string path = std::string(dir) + "/log";
+	std::string idx = path + ".idx";
+
+	{
+		record_log_writer w(path);
+
+		for (uint32_t i = 0; i < 10; i++) {
+			auto buf = gen_record(i);
+			CHECK(w.append(buf.data(), buf.size() / 2, 10*i) == i);
+		}
+
+		// timestamps can't go backwards
+		auto buf = gen_record(0);
+		bool threw = false;
+
+		try {
+			w.append(buf.data(), buf.size() / 2, 0);
+		} catch (const std::invalid_argument&) {
+			threw = true;
+		}
+
+		CHECK(threw);
+		w.sync();
+
+		// only one writer at a time, and no compacting under it
+		CHECK(throws_runtime_error([](const std::string& p) { record_log_writer x(p); }, path));
+		CHECK(throws_runtime_error([](const std::string& p) { compact_log(p, 0); }, path));
+
+		check_records(path, 0, 10);
+		CHECK(record_log(path).find(35) == 4);
+		CHECK(record_log(path).find(1000) == 10);
+	}
+
+	// an index that's behind the log is scanned past by readers, and
+	// caught up by the next writer
+	CHECK(truncate(idx.c_str(), 7*LOG_INDEX_ENTRY) == 0);
+	check_records(path, 0, 10);
+
+	{
+		record_log_writer w(path);
+		CHECK(w.records() == 10);
+	}
+
+	CHECK(file_size(idx) == 10*LOG_INDEX_ENTRY);
+
+	// a torn record at the end is dropped
+	off_t log_size = file_size(path);
+	auto buf = gen_record(10);
+
+	{
+		uint32_t header[4] = {htonl(LOG_FRAME_MAGIC), htonl(buf.size() / 2), 0, htonl(100)};
+		int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+
+		CHECK(write(fd, header, sizeof(header)) == sizeof(header));
+		CHECK(write(fd, buf.data(), 12) == 12);
+		close(fd);
+	}
+
+	{
+		record_log_writer w(path);
+		CHECK(w.records() == 10);
+		CHECK(file_size(path) == log_size);
+		CHECK(w.append(buf.data(), buf.size() / 2, 100) == 10);
+	}
+
+	check_records(path, 0, 11);
+
+	// compaction keeps records at or after the timestamp and rebuilds the
+	// index, and a writer can carry on afterwards
+	compact_log(path, 45);
+	check_records(path, 5, 6);
+	CHECK(file_size(idx) == 6*LOG_INDEX_ENTRY);
+	CHECK(file_size(path + ".compact") < 0);
+	CHECK(file_size(path + ".compact.idx") < 0);
+
+	{
+		record_log_writer w(path);
+		auto buf = gen_record(11);
+		CHECK(w.records() == 6);
+		CHECK(w.append(buf.data(), buf.size() / 2, 110) == 6);
+	}
+
+	check_records(path, 5, 7);
+
+	// everything gone
+	compact_log(path, 1000);
+	check_records(path, 0, 0);
+
+	unlink(path.c_str());
+	unlink(idx.c_str());
+	rmdir(dir);
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// checks that stream_reader hands out whole entities however the input is
+// split up, and that it can be destroyed while waiting on a pipe whose
+// writer is still open
+#include <anserial/anserial.hpp>
+#include <anserial/stream_reader.hpp>
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::vector<uint32_t> gen_records(unsigned records) {
+	serializer ser;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	for (uint32_t i = 0; i < records; i++) {
+		ser.add_entities(cont, {"record", {"id", i}, {"name", "abc"}});
+	}
+
+	ser.add_symtab(top);
+	return ser.serialize();
+}
+
+// everything the reader hands out, in order
+static std::vector<uint32_t> read_all(stream_reader& r) {
+	std::vector<uint32_t> ret;
+	size_t n;
+
+	while (uint32_t *datas = r.next(n)) {
+		ret.insert(ret.end(), datas, datas + 2*n);
+	}
+
+	// a last call at the end of input can come back empty
+	while (r.next(n)) {}
+
+	return ret;
+}
+
+static void on_alarm(int) {
+	static const char msg[] = "stream_reader test timed out\n";
+	(void)!write(2, msg, sizeof(msg) - 1);
+	_exit(1);
+}
+
+int main(void) {
+	// a hang here is a failure, not a stuck build
+	signal(SIGALRM, on_alarm);
+	alarm(30);
+
+	auto buf = gen_records(500);
+	const uint8_t *bytes = (const uint8_t*)buf.data();
+	size_t len = buf.size() * 4;
+
+	// odd sized writes through a pipe, so entities are split across reads
+	for (bool read_ahead : {false, true}) {
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			close(fds[0]);
+
+			for (size_t pos = 0, step = 1; pos < len; pos += step, step = step % 13 + 1) {
+				size_t n = (len - pos < step)? len - pos : step;
+				(void)!write(fds[1], bytes + pos, n);
+			}
+
+			_exit(0);
+		}
+
+		close(fds[1]);
+
+		stream_reader r(fds[0], 64, read_ahead);
+		CHECK(read_all(r) == buf);
+		CHECK(r.bytes_read() == len);
+		CHECK(r.trailing_bytes() == 0);
+
+		close(fds[0]);
+	}
+
+	// truncated input leaves bytes of a partial entity
+	{
+		FILE *fp = tmpfile();
+		CHECK(fwrite(bytes, 1, len - 3, fp) == len - 3);
+		rewind(fp);
+
+		stream_reader r(fp, 4096);
+		deserializer der;
+		CHECK(r.feed(der) == buf.size() / 2 - 1);
+		CHECK(r.trailing_bytes() == 5);
+
+		delete der.deserialize();
+		fclose(fp);
+	}
+
+	// the writer never closes, so the read-ahead thread is left waiting
+	// for more input when the reader goes away
+	{
+		int fds[2];
+		CHECK(pipe(fds) == 0);
+		CHECK(write(fds[1], bytes, 64) == 64);
+
+		{
+			stream_reader r(fds[0], 4096);
+			size_t n;
+			CHECK(r.next(n) && n == 8);
+			usleep(10000);
+		}
+
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,154 @@
+// checks that symbol_table loads what the serializer writes from either
+// byte order or a deserialized tree, and that it reports names which
+// don't hash to their key and keys given more than one name
+#include <anserial/anserial.hpp>
+#include <anserial/symbol_table.hpp>
+#include <stdio.h>
+#include <string.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+static std::string name(unsigned i) {
+	return "sym" + std::to_string(i);
+}
+
+// enough symbols for the table to grow a few times
+static std::vector<uint32_t> gen_symbols(ent_order order, bool dedup) {
+	serializer ser;
+	ser.order = order;
+	ser.dedup = dedup;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	for (unsigned i = 0; i < 100; i++) {
+		ser.add_symbol(cont, name(i));
+	}
+
+	// with dedup on, the symtab string for this is a reference here
+	ser.add_string(top, "sym0");
+	ser.add_symtab(0);
+	return ser.serialize();
+}
+
+static bool has(const symbol_table& tab, uint32_t hash, const char *want) {
+	std::string_view out;
+	return tab.find(hash, out) && out == want;
+}
+
+// a ::symtab of hash/name pairs, written as given
+static std::vector<uint32_t> gen_symtab(std::initializer_list<std::pair<uint32_t, const char*>> names) {
+	serializer ser;
+	uint32_t top = ser.add_map(0);
+	ser.add_symbol(top, hash_symbol("::symtab"));
+	uint32_t st = ser.add_map(top);
+
+	for (auto& [hash, str] : names) {
+		ser.add_symbol(st, hash);
+		ser.add_string(st, str);
+	}
+
+	return ser.serialize();
+}
+
+static void check_symbols(const symbol_table& tab) {
+	CHECK(tab.size() >= 100);
+	CHECK(tab.collisions().empty());
+	CHECK(tab.mismatches().empty());
+
+	for (unsigned i = 0; i < 100; i++) {
+		CHECK(has(tab, hash_symbol(name(i)), name(i).c_str()));
+	}
+
+	CHECK(!tab.contains(hash_symbol("missing")));
+}
+
+int main(void) {
+	for (ent_order order : {ORDER_NETWORK, ORDER_NATIVE}) {
+		for (bool dedup : {false, true}) {
+			auto buf = gen_symbols(order, dedup);
+			symbol_table tab(buf.data(), buf.size() / 2);
+			check_symbols(tab);
+
+			deserializer der(buf);
+			s_node *root = der.deserialize();
+			symbol_table from_tree(root->get("::symtab"));
+			check_symbols(from_tree);
+			CHECK(from_tree.size() == tab.size());
+
+			// batches, missing ones coming back null
+			uint32_t hashes[] = {hash_symbol("sym5"), hash_symbol("missing"), hash_symbol("sym99")};
+			std::string_view out[3];
+			tab.resolve(hashes, 3, out);
+			CHECK(out[0] == "sym5" && out[1].data() == nullptr && out[2] == "sym99");
+
+			std::vector<std::string_view> names;
+			s_node *cont = root->get("::data")->get(0);
+			tab.resolve(cont, names);
+			CHECK(names.size() == 100);
+			CHECK(names.size() == 100 && names[0] == "sym0" && names[42] == "sym42");
+
+			delete root;
+		}
+	}
+
+	uint32_t a = hash_symbol("a");
+	uint32_t b = hash_symbol("b");
+
+	// the same name twice is fine
+	{
+		auto buf = gen_symtab({{a, "a"}, {b, "b"}, {a, "a"}});
+		symbol_table tab(buf.data(), buf.size() / 2);
+		CHECK(tab.size() == 2);
+		CHECK(tab.collisions().empty() && tab.mismatches().empty());
+	}
+
+	// a key with two names keeps the later one and reports both, the
+	// name that doesn't hash to the key is reported too
+	{
+		auto buf = gen_symtab({{a, "a"}, {b, "b"}, {a, "c"}});
+		symbol_table tab(buf.data(), buf.size() / 2);
+		CHECK(tab.size() == 2);
+		CHECK(has(tab, a, "c") && has(tab, b, "b"));
+
+		auto& c = tab.collisions();
+		CHECK(c.size() == 1);
+		CHECK(c.size() == 1 && c[0].hash == a && c[0].first == "a" && c[0].second == "c");
+		CHECK(tab.mismatches() == std::vector<uint32_t>{a});
+
+		// loading again starts over
+		buf = gen_symtab({{b, "b"}});
+		tab.load(buf.data(), buf.size() / 2);
+		CHECK(tab.size() == 1 && tab.collisions().empty() && tab.mismatches().empty());
+	}
+
+	// the same through add()
+	{
+		symbol_table tab;
+		tab.add(a, "a");
+		tab.add(a, "x");
+		tab.add(b, "b");
+		CHECK(tab.collisions().size() == 1 && tab.mismatches().size() == 1);
+		CHECK(has(tab, a, "x"));
+	}
+
+	// no ::symtab at all
+	{
+		serializer ser;
+		ser.default_layout();
+		auto buf = ser.serialize();
+		symbol_table tab(buf.data(), buf.size() / 2);
+		CHECK(tab.size() == 0 && !tab.contains(a));
+	}
+
+	return failures? 1 : 0;
+}
@@ -0,0 +1,105 @@
+// checks that the try_*() accessors return nothing instead of throwing on
+// every kind of mismatch, where the plain accessors throw, and that
+// destructure() fails to match quietly
+#include <anserial/anserial.hpp>
+#include <stdexcept>
+#include <stdio.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+template <typename E, typename F>
+static bool throws(F fn) {
+	try {
+		fn();
+	} catch (const E&) {
+		return true;
+	}
+
+	return false;
+}
+
+int main(void) {
+	serializer ser;
+	uint32_t data = ser.default_layout();
+	uint32_t map = ser.add_map(data);
+	ser.add_symbol(map, "name");
+	ser.add_string(map, "abc");
+	ser.add_symbol(map, "count");
+	ser.add_integer(map, 5);
+	ser.add_symbol(map, "tag");
+	ser.add_symbol(map, "red");
+	ser.add_symbol(map, "list");
+	uint32_t list = ser.add_container(map);
+	ser.add_integer(list, 1);
+	ser.add_integer(list, 2);
+	ser.add_ent(ENT_TYPE_REF, data, map);
+	ser.add_symtab(0);
+
+	deserializer der(ser.serialize());
+	s_node *root = der.deserialize();
+	s_node *rec = root->get("::data")->get(0);
+	s_node *ref = root->get("::data")->get(1);
+
+	// present, with the right types
+	CHECK(rec->try_get("name") && *rec->try_get("name")->try_string() == "abc");
+	CHECK(rec->try_get("count")->try_uint() == 5u);
+	CHECK(rec->try_get("tag")->try_uint() == hash_string("red"));
+	CHECK(rec->try_get("list")->try_get(1)->try_uint() == 2u);
+
+	// missing entries, and maps don't grow from looking
+	size_t entries = rec->entities().size();
+	CHECK(rec->try_get("missing") == nullptr);
+	CHECK(rec->get("missing") == nullptr);
+	CHECK(rec->entities().size() == entries);
+
+	s_node *lst = rec->try_get("list");
+	CHECK(lst->try_get(2) == nullptr);
+	CHECK(throws<std::out_of_range>([&] { lst->get(2); }));
+
+	// type mismatches
+	s_node *str = rec->try_get("name");
+	s_node *num = rec->try_get("count");
+
+	CHECK(!str->try_uint());
+	CHECK(throws<std::logic_error>([&] { str->uint(); }));
+	CHECK(num->try_string() == nullptr);
+	CHECK(throws<std::logic_error>([&] { num->string(); }));
+	CHECK(num->try_get(0) == nullptr);
+	CHECK(num->try_get("name") == nullptr);
+	CHECK(throws<std::logic_error>([&] { num->get(0); }));
+	CHECK(lst->try_get("name") == nullptr);
+	CHECK(!lst->try_uint());
+
+	// references answer for their target
+	CHECK(ref->try_get("count")->try_uint() == 5u);
+	CHECK(ref->try_get("missing") == nullptr);
+	CHECK(!ref->try_uint());
+
+	// destructure binds what matches, and fails without throwing on
+	// anything that doesn't
+	uint32_t count = 0, first = 0;
+	s_node *name = nullptr;
+
+	CHECK(destructure(rec, {"count", &count, "name", &name, "list", {&first}}));
+	CHECK(count == 5 && name == str && first == 1);
+
+	CHECK(!destructure(rec, {"count", "abc"}));
+	CHECK(!destructure(rec, {"missing", &count}));
+	CHECK(!destructure(rec, {"list", {1u, 2u, 3u}}));
+	CHECK(!destructure(num, {"count", &count}));
+	CHECK(destructure(rec, {"list", {1u, 2u}}));
+	CHECK(destructure(ref, {"tag", "red"}) == destructure(rec, {"tag", "red"}));
+
+	delete root;
+	return failures? 1 : 0;
+}
@@ -0,0 +1,225 @@
+// checks the validator against hand-made and corrupted buffers, and that
+// anything it accepts deserializes and decodes without throwing or looping
+#include <anserial/anserial.hpp>
+#include <anserial/binding.hpp>
+#include <anserial/validate.hpp>
+#include <anserial/view.hpp>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct node_t {
+	uint32_t value;
+	std::vector<node_t> kids;
+};
+
+ANSERIAL_BINDING(node_t,
+	ANSERIAL_FIELD(value),
+	ANSERIAL_FIELD(kids));
+
+struct ent { uint32_t type, parent, data; };
+
+// written as-is in network order, the serializer won't write most of these
+static std::vector<uint32_t> build(std::initializer_list<ent> ents) {
+	std::vector<uint32_t> ret;
+
+	for (const ent& e : ents) {
+		ret.push_back(htonl(e.type << 29 | e.parent));
+		ret.push_back(htonl(e.data));
+	}
+
+	return ret;
+}
+
+static void check_rejected(const std::vector<uint32_t>& buf, uint32_t entity,
+                           const char *error)
+{
+	validation v = validate(buf);
+	CHECK(!v.ok());
+	CHECK(v.entity == entity);
+	CHECK(v.error && strcmp(v.error, error) == 0);
+}
+
+static std::vector<uint32_t> gen_records(bool dedup) {
+	serializer ser;
+	ser.dedup = dedup;
+	uint32_t top = ser.default_layout();
+	uint32_t cont = ser.add_container(top);
+
+	for (uint32_t i = 0; i < 200; i++) {
+		ser.add_entities(cont,
+			{"record",
+				{"id", i % 16},
+				{"name", "abc"}});
+	}
+
+	ser.add_symtab(top);
+	return ser.serialize();
+}
+
+int main(void) {
+	uint32_t kids = hash_symbol("kids");
+
+	// serializer output always passes, references and all
+	for (bool dedup : {false, true}) {
+		CHECK(validate(gen_records(dedup)).ok());
+	}
+
+	// {kids: [ref -> top]} contains itself
+	{
+		auto buf = build({
+			{ENT_TYPE_MAP,       0, 0},
+			{ENT_TYPE_SYMBOL,    0, kids},
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_REF,       2, 0},
+		});
+
+		check_rejected(buf, 3, "reference to its own ancestor");
+
+		node_t out;
+		CHECK(!decode(buf, 0, out));
+
+		auto list = view<node_t>(buf, 0).get<&node_t::kids>();
+		CHECK(list.size() == 1);
+		CHECK(!list[0].valid());
+	}
+
+	// a reference to an earlier sibling is fine, and decodes as a copy
+	{
+		uint32_t value = hash_symbol("value");
+		auto buf = build({
+			{ENT_TYPE_MAP,       0, 0},
+			{ENT_TYPE_SYMBOL,    0, value},
+			{ENT_TYPE_INTEGER,   0, 7},
+			{ENT_TYPE_SYMBOL,    0, kids},
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_MAP,       4, 0},
+			{ENT_TYPE_SYMBOL,    5, value},
+			{ENT_TYPE_INTEGER,   5, 42},
+			{ENT_TYPE_REF,       4, 5},
+		});
+
+		CHECK(validate(buf).ok());
+
+		node_t out;
+		CHECK(decode(buf, 0, out));
+		CHECK(out.value == 7);
+		CHECK(out.kids.size() == 2 && out.kids[1].value == 42);
+	}
+
+	// two subtrees referring to each other, both closed when referred to,
+	// the second one is grown after it's been referenced
+	{
+		auto buf = build({
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_REF,       1, 2},
+			{ENT_TYPE_REF,       2, 1},
+		});
+
+		check_rejected(buf, 3, "reference to a subtree that grows after it");
+	}
+
+	// growing a closed subtree nothing refers to is fine
+	{
+		auto buf = build({
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_CONTAINER, 1, 0},
+			{ENT_TYPE_CONTAINER, 0, 0},
+			{ENT_TYPE_INTEGER,   2, 1},
+			{ENT_TYPE_REF,       3, 2},
+		});
+
+		CHECK(validate(buf).ok());
+	}
+
+	// the other structural rules
+	check_rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_INTEGER,   2, 0},
+	}), 1, "parent doesn't come first");
+
+	check_rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_REF,       0, 1},
+	}), 1, "reference doesn't point back");
+
+	check_rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_INTEGER,   0, 0},
+		{ENT_TYPE_INTEGER,   1, 0},
+	}), 2, "parent can't have children");
+
+	check_rejected(build({
+		{ENT_TYPE_MAP,       0, 0},
+		{ENT_TYPE_INTEGER,   0, 0},
+		{ENT_TYPE_INTEGER,   0, 0},
+	}), 1, "map key isn't a symbol");
+
+	check_rejected(build({
+		{ENT_TYPE_MAP,       0, 0},
+		{ENT_TYPE_SYMBOL,    0, kids},
+	}), 0, "map key without a value");
+
+	check_rejected(build({
+		{ENT_TYPE_CONTAINER, 0, 0},
+		{ENT_TYPE_STRING,    0, 0},
+		{ENT_TYPE_INTEGER,   1, 'a'},
+		{ENT_TYPE_REF,       0, 2},
+	}), 3, "reference to a string character");
+
+	// corrupted copies of real output either fail validation or go
+	// through the deserializer and decode without trouble
+	{
+		auto base = gen_records(true);
+		uint32_t state = 19937;
+		unsigned passed = 0;
+
+		for (unsigned n = 0; n < 5000; n++) {
+			auto buf = base;
+
+			for (unsigned k = 0; k < 3; k++) {
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				buf[2 + state % (buf.size() - 2)] ^= 1u << (state >> 27);
+			}
+
+			if (!validate(buf).ok()) {
+				continue;
+			}
+
+			passed++;
+
+			try {
+				deserializer der(buf);
+				delete der.deserialize();
+			} catch (const std::exception& e) {
+				fprintf(stderr, "accepted buffer %u failed to deserialize: %s\n",
+				        n, e.what());
+				failures++;
+			}
+
+			node_t out;
+			decode(buf, 0, out);
+		}
+
+		CHECK(passed > 0);
+	}
+
+	return failures? 1 : 0;
+}
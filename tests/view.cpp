@@ -0,0 +1,133 @@
+// checks that list_view elements laid out like the first one reuse its
+// field offsets, and that elements laid out differently still read the
+// right values by searching their maps
+#include <anserial/anserial.hpp>
+#include <anserial/view.hpp>
+#include <stdio.h>
+
+using namespace anserial;
+
+static unsigned failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+struct item {
+	uint32_t id;
+	std::string name;
+	uint32_t count;
+};
+
+ANSERIAL_BINDING(item,
+	ANSERIAL_FIELD(id),
+	ANSERIAL_FIELD(name),
+	ANSERIAL_FIELD(count));
+
+struct doc {
+	std::vector<item> items;
+};
+
+ANSERIAL_BINDING(doc,
+	ANSERIAL_FIELD(items));
+
+// fields in the given order, anything else is left out
+static uint32_t add_item(serializer& ser, uint32_t parent, const item& it,
+                         const char *order)
+{
+	uint32_t map = ser.add_map(parent);
+
+	for (const char *c = order; *c; c++) {
+		switch (*c) {
+			case 'i': ser.add_symbol(map, "id");    ser.add_integer(map, it.id); break;
+			case 'n': ser.add_symbol(map, "name");  ser.add_string(map, it.name); break;
+			case 'c': ser.add_symbol(map, "count"); ser.add_integer(map, it.count); break;
+			case 'x': ser.add_symbol(map, "extra"); ser.add_integer(map, 0); break;
+		}
+	}
+
+	return map;
+}
+
+int main(void) {
+	struct { item it; const char *order; bool same_layout; } items[] = {
+		{{1, "abc", 10},    "inc",  true},
+		{{2, "def", 20},    "inc",  true},
+		// same shape with id and count swapped, so the offsets line up
+		// but the keys don't
+		{{3, "ghi", 30},    "cni",  false},
+		// a longer name moves count along
+		{{4, "jklmno", 40}, "inc",  false},
+		{{5, "pqr", 0},     "in",   false},
+		{{6, "stu", 60},    "xinc", false},
+		{{7, "vwx", 70},    "inc",  true},
+	};
+
+	serializer ser;
+	uint32_t data = ser.default_layout();
+	uint32_t top = ser.add_map(data);
+	ser.add_symbol(top, "items");
+	uint32_t list = ser.add_container(top);
+	uint32_t first = 0;
+
+	for (auto& x : items) {
+		uint32_t id = add_item(ser, list, x.it, x.order);
+		first = first? first : id;
+	}
+
+	// a reference to the first element reads the same as it
+	ser.add_ent(ENT_TYPE_REF, list, first);
+	ser.add_symtab(0);
+
+	auto buf = ser.serialize();
+	view<doc> d(buf, top);
+	CHECK(d.valid());
+
+	auto lv = d.get<&doc::items>();
+	size_t n = sizeof(items) / sizeof(items[0]);
+	CHECK(lv.size() == n + 1);
+
+	auto layout = lv[0].offsets();
+
+	for (size_t i = 0; i <= n && i < lv.size(); i++) {
+		const item& want = items[(i < n)? i : 0].it;
+		auto v = lv[i];
+
+		CHECK(v.valid());
+		CHECK(v.get<&item::id>() == want.id);
+		CHECK(v.get<&item::name>() == want.name);
+		CHECK(v.get<&item::count>() == want.count);
+		CHECK(v.has<2>() == (i >= n || items[i].order[2] != '\0'));
+
+		// an element found at the first one's offsets has the same
+		// layout, and a fresh view without the hint agrees with it
+		view<item> fresh(buf, v.entity());
+		CHECK(fresh.offsets() == v.offsets());
+
+		if (i < n) {
+			CHECK((v.offsets() == layout) == items[i].same_layout);
+		}
+
+		item out{};
+		CHECK(v.materialize(out));
+		CHECK(out.id == want.id && out.name == want.name && out.count == want.count);
+	}
+
+	// and the whole thing decodes the same way
+	doc out;
+	CHECK(decode(buf, top, out));
+	CHECK(out.items.size() == n + 1);
+	CHECK(out.items[n].id == 1 && out.items[n].name == "abc");
+
+	// a view pointed at something other than a map is invalid, and reads
+	// give defaults
+	view<item> bad(buf, list);
+	CHECK(!bad.valid());
+	CHECK(bad.get<&item::id>() == 0 && bad.get<&item::name>() == "");
+
+	return failures? 1 : 0;
+}